@@ -0,0 +1,185 @@
+#include "FileHandler/LexerFileReader.hpp"
+#include "LexerSinks.hpp"
+#include "LexicalAnalyzer.hpp"
+#include "PerfCounters.hpp"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <print>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Lexing throughput, with hardware counters per byte and per token to tell branch misses from cache misses
+// Usage: ./specula-lexer-bench [--counters] [--runs n] [--sink name] [file] ...
+// Without files, synthetic inputs stressing different states of the lexer are used
+// Every sink of BasicLexer is measured unless one is picked, the gap to count is what storing tokens costs
+
+namespace {
+
+struct BenchInput {
+    std::string name;
+    std::string source;
+};
+
+std::string repeat(std::string_view text, std::size_t bytes)
+{
+    std::string source;
+    source.reserve(bytes + text.size());
+    while (source.size() < bytes) {
+        source += text;
+    }
+    return source;
+}
+
+std::vector<BenchInput> makeInputs(std::size_t bytes)
+{
+    return {
+        { "mixed", repeat("fn add(a: int, b: int) {\n    let sum = a + b; // adds\n    ret sum * 2.5f;\n}\nlet name = \"specula\";\n", bytes) },
+        { "idents", repeat("alpha beta_gamma delta2 init-state epsilon zeta_eta theta\n", bytes) },
+        { "numbers", repeat("1 23 456 7.5 8.25f 90000 0.125 42\n", bytes) },
+        { "strings", repeat("\"a plain string\" \"with \\\"escapes\\\" \\n\" 'c' '\\t'\n", bytes) },
+        { "operators", repeat("a += b << 2; c = d != e && f >= g || !h; i->j; k++;\n", bytes) },
+        { "comments", repeat("// a line comment that the lexer skips\n/* and a block\n   comment */\n", bytes) },
+    };
+}
+
+struct BenchResult {
+    std::chrono::nanoseconds duration; // fastest run
+    std::size_t tokens;
+    PerfCounters::Values counters; // of the fastest run
+};
+
+template <class Lexer>
+BenchResult run(const std::string& source, std::size_t runs, PerfCounters* counters)
+{
+    // Reused like in a server, so the runs after the first do not allocate
+    Lexer lexer;
+    std::size_t streamed = 0;
+    if constexpr (std::is_same_v<Lexer, StreamingLexer>) {
+        lexer.getSink().setConsumer([&streamed](std::span<const Token> batch) { streamed += batch.size(); });
+    }
+    BenchResult best { std::chrono::nanoseconds::max(), 0, {} };
+    for (std::size_t i = 0; i < runs; i++) {
+        lexer.reset();
+        if (counters != nullptr) {
+            counters->start();
+        }
+        auto start = std::chrono::steady_clock::now();
+        lexer.buildTokens(source);
+        auto duration = std::chrono::steady_clock::now() - start;
+        PerfCounters::Values values = counters != nullptr ? counters->stop() : PerfCounters::Values {};
+        if (duration < best.duration) {
+            best = { duration, lexer.getSink().getTokenCount(), values };
+        }
+    }
+    return best;
+}
+
+struct BenchSink {
+    std::string_view name;
+    BenchResult (*run)(const std::string& source, std::size_t runs, PerfCounters* counters);
+};
+
+// From the most work per token to the least
+constexpr BenchSink sinks[] = {
+    { "store", &run<LexicalAnalyzer> },
+    { "stream", &run<StreamingLexer> },
+    { "validate", &run<ValidatingLexer> },
+    { "count", &run<CountingLexer> },
+};
+
+void printResult(const BenchInput& input, std::string_view sink, const BenchResult& result, bool hasCounters)
+{
+    double seconds = std::chrono::duration<double>(result.duration).count();
+    double bytes = static_cast<double>(input.source.size());
+    double tokens = static_cast<double>(std::max<std::size_t>(result.tokens, 1));
+    std::print("{} {} ({:.1f} MiB, {} tokens): {:.1f} MiB/s, {:.1f} Mtokens/s\n", input.name, sink, bytes / (1 << 20), result.tokens,
+        bytes / (1 << 20) / seconds, tokens / 1e6 / seconds);
+    if (!hasCounters) {
+        return;
+    }
+    std::print("    {:<14} {:>12} {:>12}\n", "", "per byte", "per token");
+    for (std::size_t i = 0; i < PerfCounters::COUNT; i++) {
+        const std::optional<double>& value = result.counters[i];
+        if (value.has_value()) {
+            std::print("    {:<14} {:>12.4f} {:>12.4f}\n", PerfCounters::names[i], *value / bytes, *value / tokens);
+        } else {
+            std::print("    {:<14} {:>12} {:>12}\n", PerfCounters::names[i], "n/a", "n/a");
+        }
+    }
+    const std::optional<double>& cycles = result.counters[PerfCounters::CYCLES];
+    const std::optional<double>& instructions = result.counters[PerfCounters::INSTRUCTIONS];
+    if (cycles.has_value() && instructions.has_value() && *cycles > 0) {
+        std::print("    {:<14} {:>12.2f}\n", "IPC", *instructions / *cycles);
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    bool isCounting = false;
+    std::size_t runs = 5;
+    std::optional<std::string_view> onlySink;
+    std::vector<BenchInput> inputs;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg { argv[i] };
+        if (arg == "--counters") {
+            isCounting = true;
+            continue;
+        }
+        if (arg == "--runs" && i + 1 < argc) {
+            std::string_view value { argv[++i] };
+            auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), runs);
+            if (error != std::errc {} || end != value.data() + value.size() || runs == 0) {
+                std::print("Invalid value for --runs: {}\n", value);
+                return 1;
+            }
+            continue;
+        }
+        if (arg == "--sink" && i + 1 < argc) {
+            onlySink = argv[++i];
+            if (std::ranges::none_of(sinks, [&](const BenchSink& sink) { return sink.name == *onlySink; })) {
+                std::print("Unknown sink: {}, expected store, stream, validate or count\n", *onlySink);
+                return 1;
+            }
+            continue;
+        }
+        std::expected<std::string, LexFailure> source = LexerFileReader::readSource(argv[i], 0);
+        if (!source.has_value()) {
+            std::print("Cannot read file: {}\n", arg);
+            return 1;
+        }
+        inputs.push_back({ std::string { arg }, std::move(*source) });
+    }
+    if (inputs.empty()) {
+        inputs = makeInputs(8 << 20);
+    }
+
+    std::optional<PerfCounters> counters;
+    if (isCounting) {
+        counters.emplace();
+        if (!counters->isAvailable()) {
+            // Usual in containers and with kernel.perf_event_paranoid above 2, throughput is still measured
+            std::print("Hardware counters are unavailable, reporting throughput only\n");
+            counters.reset();
+        }
+    }
+
+    std::print("fastest of {} runs\n", runs);
+    for (const BenchInput& input : inputs) {
+        for (const BenchSink& sink : sinks) {
+            if (onlySink.has_value() && sink.name != *onlySink) {
+                continue;
+            }
+            BenchResult result = sink.run(input.source, runs, counters.has_value() ? &*counters : nullptr);
+            printResult(input, sink.name, result, counters.has_value());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "PerfCounters.hpp"
+#include <algorithm>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#if defined(__linux__)
+int openCounter(std::uint32_t type, std::uint64_t config)
+{
+    perf_event_attr attributes {};
+    attributes.size = sizeof(attributes);
+    attributes.type = type;
+    attributes.config = config;
+    attributes.disabled = 1;
+    // Only the lexer's own work, which also lets perf_event_paranoid 2 allow it
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+}
+
+constexpr std::uint64_t getCacheConfig(std::uint64_t cache)
+{
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+#endif
+
+}
+
+PerfCounters::PerfCounters()
+{
+    mFds.fill(-1);
+#if defined(__linux__)
+    mFds[CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    mFds[INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    mFds[BRANCH_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    mFds[L1D_MISSES] = openCounter(PERF_TYPE_HW_CACHE, getCacheConfig(PERF_COUNT_HW_CACHE_L1D));
+    mFds[LLC_MISSES] = openCounter(PERF_TYPE_HW_CACHE, getCacheConfig(PERF_COUNT_HW_CACHE_LL));
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#if defined(__linux__)
+    for (int fd : mFds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+bool PerfCounters::isAvailable() const
+{
+    return std::ranges::any_of(mFds, [](int fd) { return fd >= 0; });
+}
+
+void PerfCounters::start()
+{
+#if defined(__linux__)
+    for (int fd : mFds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+PerfCounters::Values PerfCounters::stop()
+{
+    Values values;
+#if defined(__linux__)
+    for (int fd : mFds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (std::size_t i = 0; i < COUNT; i++) {
+        // value, time enabled, time running
+        std::uint64_t data[3] = {};
+        if (mFds[i] < 0 || read(mFds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+            continue;
+        }
+        values[i] = static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]);
+    }
+#endif
+    return values;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+/**
+ * Hardware counters of the calling thread, read with perf_event_open on Linux
+ * Counters the kernel refuses (no PMU in a container, perf_event_paranoid, other systems) read as empty
+ * Values are scaled when the kernel had to multiplex the counters
+ */
+class PerfCounters {
+public:
+    enum Counter : std::uint8_t {
+        CYCLES,
+        INSTRUCTIONS,
+        BRANCH_MISSES,
+        L1D_MISSES,
+        LLC_MISSES,
+        COUNT
+    };
+
+    static constexpr std::array<std::string_view, COUNT> names = { "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses" };
+
+    using Values = std::array<std::optional<double>, COUNT>;
+
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * Whether at least one counter could be opened
+     */
+    bool isAvailable() const;
+
+    /**
+     * Zeroes and enables the counters
+     */
+    void start();
+
+    /**
+     * Disables the counters and reads what they counted since start
+     */
+    Values stop();
+
+private:
+    std::array<int, COUNT> mFds;
+};
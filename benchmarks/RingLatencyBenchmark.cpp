@@ -0,0 +1,157 @@
+#include "FileHandler/LexerFileWriter.hpp"
+#include "FileHandler/TokenRing.hpp"
+#include "LexicalAnalyzer.hpp"
+#include "LineIndex.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <nlohmann/json.hpp>
+#include <print>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Compares how long a parser waits for tokens when they come through a JSON file and through the shared memory ring
+// Usage: ./specula-ring-bench [source MiB] [runs]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Timing {
+    std::chrono::nanoseconds firstToken; // from the start of the lex until the consumer has the first token
+    std::chrono::nanoseconds lastToken;
+    std::uint64_t tokens;
+};
+
+std::string makeSource(std::size_t bytes)
+{
+    constexpr std::string_view function = "fn add(a: int, b: int) {\n"
+                                          "    let sum = a + b; // adds\n"
+                                          "    ret sum * 2.5f;\n"
+                                          "}\n"
+                                          "let name = \"specula\";\n";
+    std::string source;
+    source.reserve(bytes + function.size());
+    while (source.size() < bytes) {
+        source += function;
+    }
+    return source;
+}
+
+// The whole file has to be written and parsed back before the first token is usable
+Timing runJson(const std::string& source, const std::filesystem::path& path)
+{
+    auto start = Clock::now();
+    LexicalAnalyzer lexer { source };
+    {
+        std::ofstream { path, std::ios::binary } << LexerFileWriter::serialize(lexer, LineIndex { source }, path.string());
+    }
+    std::ifstream readFile { path, std::ios::binary };
+    nlohmann::json output = nlohmann::json::parse(readFile);
+    auto end = Clock::now();
+    return { end - start, end - start, output["tokens"].size() };
+}
+
+// The consumer runs on its own thread, reading while the lexer still produces
+Timing runRing(const std::string& source, const std::string& name)
+{
+    TokenRingWriter ring { name };
+    TokenRingReader reader { name };
+    std::atomic<Clock::time_point> start;
+    Timing timing {};
+
+    std::jthread consumer { [&] {
+        std::array<TokenRecord, 256> records;
+        bool isFirst = true;
+        while (true) {
+            std::size_t count = reader.read(records);
+            if (count == 0) {
+                if (reader.isFinished()) {
+                    return;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            if (isFirst) {
+                timing.firstToken = Clock::now() - start.load();
+                isFirst = false;
+            }
+            for (const TokenRecord& record : std::span { records }.first(count)) {
+                if (record.type == TokenRecord::endOfFile) {
+                    timing.lastToken = Clock::now() - start.load();
+                } else {
+                    timing.tokens++;
+                }
+            }
+        }
+    } };
+
+    start.store(Clock::now());
+    LexicalAnalyzer lexer;
+    lexer.setTokenCallback([&ring](std::span<const Token> tokens) { ring.write(tokens); });
+    lexer.buildTokens(source);
+    ring.endFile(source.size());
+    ring.close();
+    consumer.join();
+    return timing;
+}
+
+std::chrono::nanoseconds median(std::vector<std::chrono::nanoseconds> values)
+{
+    auto middle = values.begin() + values.size() / 2;
+    std::ranges::nth_element(values, middle);
+    return *middle;
+}
+
+void printRow(std::string_view transport, std::span<const Timing> timings)
+{
+    std::vector<std::chrono::nanoseconds> first;
+    std::vector<std::chrono::nanoseconds> last;
+    for (const Timing& timing : timings) {
+        first.push_back(timing.firstToken);
+        last.push_back(timing.lastToken);
+    }
+    using Microseconds = std::chrono::duration<double, std::micro>;
+    std::print("{:<6} {:>16.1f} {:>16.1f} {:>12}\n", transport, Microseconds { median(first) }.count(), Microseconds { median(last) }.count(), timings.front().tokens);
+}
+
+std::size_t parseArgument(const char* text, std::size_t fallback)
+{
+    std::size_t value = 0;
+    std::string_view view { text };
+    auto [end, error] = std::from_chars(view.data(), view.data() + view.size(), value);
+    return error == std::errc {} && end == view.data() + view.size() && value > 0 ? value : fallback;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t mebibytes = argc > 1 ? parseArgument(argv[1], 8) : 8;
+    std::size_t runs = argc > 2 ? parseArgument(argv[2], 5) : 5;
+    std::string source = makeSource(mebibytes << 20);
+    std::filesystem::path jsonPath = std::filesystem::temp_directory_path() / "specula_ring_bench_tokens.json";
+    std::string ringName = "/specula-ring-bench";
+
+    std::vector<Timing> json;
+    std::vector<Timing> ring;
+    for (std::size_t run = 0; run < runs; run++) {
+        json.push_back(runJson(source, jsonPath));
+        ring.push_back(runRing(source, ringName));
+    }
+    std::filesystem::remove(jsonPath);
+
+    std::print("{} MiB, median of {} runs\n", mebibytes, runs);
+    std::print("{:<6} {:>16} {:>16} {:>12}\n", "", "first token us", "last token us", "tokens");
+    printRow("json", json);
+    printRow("ring", ring);
+    return 0;
+}
@@ -1,18 +1,27 @@
-import type { LexerPayload } from '../types/token';
+import type { LexerPayload, LexerToken } from '../types/token';
 
 const API_URL = import.meta.env.VITE_LEXER_API_URL || 'http://localhost:3001/lex';
 
+/**
+ * Lines [start, end) to tokenize, starting at 1
+ */
+export interface LineWindow {
+  start: number;
+  end: number;
+}
+
 /**
  * Tokenize source code by calling the REST API backend
+ * Pass lines to only receive the tokens of the visible window
  */
-export const tokenizeSource = async (source: string): Promise<LexerPayload> => {
+export const tokenizeSource = async (source: string, lines?: LineWindow): Promise<LexerPayload> => {
   try {
     const response = await fetch(API_URL, {
       method: 'POST',
       headers: {
         'Content-Type': 'application/json',
       },
-      body: JSON.stringify({ code: source }),
+      body: JSON.stringify(lines ? { code: source, lines } : { code: source }),
     });
 
     if (!response.ok) {
@@ -27,7 +36,12 @@ export const tokenizeSource = async (source: string): Promise<LexerPayload> => {
     // Frontend expects: { ok, tokens, diagnostics, error }
     const payload: LexerPayload = {
       ok: true,  
-      tokens: result.tokens || [],
+      // Identifiers carry a symbol id, their names are sent once in result.symbols
+      tokens: (result.tokens || []).map((token: LexerToken) =>
+        token.symbol !== undefined && token.value === undefined
+          ? { ...token, value: result.symbols?.[token.symbol] ?? '' }
+          : token
+      ),
       // Format diagnostics with location info for proper display
       diagnostics: result.errors?.map((err: any) => 
         `${err.message} at ${err.line}:${err.charPos}`
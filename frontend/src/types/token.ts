@@ -16,6 +16,8 @@ export interface LexerToken {
   // Fields from C++ lexer for parser compatibility
   char_start?: number;
   char_end?: number;
+  // Index into the lexer's symbol table, sent instead of value for identifiers
+  symbol?: number;
 }
 
 export interface LexerPayload {
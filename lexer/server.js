@@ -23,6 +23,13 @@ const LEXER_EXECUTABLE = process.env.LEXER_EXECUTABLE || (isWindows
   ? path.join(__dirname, '..', 'build', 'Debug', 'specula.exe')
   : path.join(__dirname, '..', 'build', 'specula'));
 
+// Budgets for one request, so a pathological input cannot hold the lexer for long
+const LEXER_LIMIT_ARGS = [
+  ['--max-tokens', process.env.LEXER_MAX_TOKENS || '2000000'],
+  ['--max-errors', process.env.LEXER_MAX_ERRORS || '10000'],
+  ['--time-limit-ms', process.env.LEXER_TIME_LIMIT_MS || '2000']
+].flat();
+
 /**
  * Generate a unique temporary filename
  */
@@ -45,11 +52,14 @@ async function cleanupFiles(inputFile, outputFile) {
 
 /**
  * POST /lex
- * Accepts: { code: string }
- * Returns: { file: {...}, errors: [...], tokens: [...] }
+ * Accepts: { code: string, lines?: { start: number, end: number }, highlight?: boolean }
+ * Returns: { file: {...}, errors: [...], symbols: [...], tokens: [...], viewport?: {...} }
+ * With lines, only the tokens on lines [start, end) are returned (lines start at 1)
+ * A "truncated": { limit, offset } entry is added when a lexer limit stopped the lex early
+ * With highlight, returns { classes: [...], errors: [...], file: {...}, spans: [gap, length, class, ...] } instead
  */
 app.post('/lex', async (req, res) => {
-  const { code } = req.body;
+  const { code, lines, highlight } = req.body;
 
   if (!code || typeof code !== 'string') {
     return res.status(400).json({
@@ -57,16 +67,30 @@ app.post('/lex', async (req, res) => {
     });
   }
 
+  const lexerArgs = [...LEXER_LIMIT_ARGS];
+  if (lines !== undefined) {
+    if (!Number.isInteger(lines?.start) || !Number.isInteger(lines?.end) || lines.start < 1 || lines.end < lines.start) {
+      return res.status(400).json({
+        error: 'Invalid "lines" field, expected { start, end } with 1 <= start <= end'
+      });
+    }
+    lexerArgs.push('--lines', `${lines.start}:${lines.end}`);
+  }
+  if (highlight === true) {
+    lexerArgs.push('--highlight');
+  }
+
   const tempInputFile = path.join(__dirname, generateTempFilename());
   const tempInputBasename = path.basename(tempInputFile, '.txt');
-  const tempOutputFile = path.join(__dirname, `${tempInputBasename}_tokens.txt`);
+  const outputSuffix = highlight === true ? '_highlight' : '_tokens';
+  const tempOutputFile = path.join(__dirname, `${tempInputBasename}${outputSuffix}.txt`);
 
   try {
     // Write input code to temporary file
     await fs.writeFile(tempInputFile, code, 'utf-8');
 
     // Execute the C++ lexer
-    const lexerProcess = spawn(LEXER_EXECUTABLE, [tempInputFile], {
+    const lexerProcess = spawn(LEXER_EXECUTABLE, [...lexerArgs, tempInputFile], {
       cwd: __dirname,
       windowsHide: true
     });
@@ -34,6 +34,24 @@ public class LexerFileReader
         {
             throw new LexerReadException($"Serialize failed. Invalid format");
         }
+        ResolveSymbols(output);
         return output;
     }
+
+    /// Identifiers are written once in the symbol table, fill their values back in
+    public static void ResolveSymbols(LexerOutput output)
+    {
+        foreach (Token token in output.Tokens)
+        {
+            if (token.Symbol is not int symbol)
+            {
+                continue;
+            }
+            if (symbol < 0 || symbol >= output.Symbols.Count)
+            {
+                throw new LexerReadException(token, $"Unknown symbol id {symbol}");
+            }
+            token.Value = output.Symbols[symbol];
+        }
+    }
 }
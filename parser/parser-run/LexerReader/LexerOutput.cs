@@ -1,3 +1,4 @@
+using System.Text.Json;
 using System.Text.Json.Serialization;
 namespace SpeculaSyntaxAnalyzer.LexerReader;
 
@@ -14,10 +15,19 @@ public class LexerFileInfo
     public required string Type { get; set; }
 }
 
+public class LexerLiteral
+{
+    public int Token { get; set; }
+    public string Kind { get; set; } = "Unknown";
+    public JsonElement Value { get; set; }
+}
+
 public class LexerOutput
 {
     [JsonPropertyName("file")]
     public required LexerFileInfo FileInfo { get; set; }
     public List<LexerError> Errors { get; set; } = new();
     public List<Token> Tokens { get; set; } = new();
+    public List<string> Symbols { get; set; } = new();
+    public List<LexerLiteral> Literals { get; set; } = new();
 }
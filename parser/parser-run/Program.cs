@@ -30,6 +30,7 @@ namespace SpeculaSyntaxAnalyzer.Controllers
         [HttpPost("analyze")]
         public IActionResult Analyze([FromBody] LexerOutput input)
         {
+            LexerFileReader.ResolveSymbols(input);
             var errorHandler = new ErrorsHandler();
             foreach (var error in input.Errors)
             {
@@ -0,0 +1,327 @@
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LexerRuleset.hpp"
+#include "Literal.hpp"
+#include "SymbolIndex.hpp"
+#include "SymbolTable.hpp"
+#include "Tokens.hpp"
+
+struct Token {
+    TokenType type;
+    std::string value;
+    std::uint64_t offset = 0; // byte offset of the first character in the source
+    std::uint32_t length = 0; // bytes covered in the source, including quotes and escapes
+    std::uint32_t symbol = SymbolTable::npos; // interned id, only set for IDENT
+};
+
+/**
+ * Bytes [offset, offset + length) of the source
+ */
+struct SourceRange {
+    std::uint64_t offset = 0;
+    std::uint32_t length = 0;
+};
+
+enum class TriviaKind : std::uint8_t {
+    WHITESPACE, // spaces and tabs
+    NEW_LINE,
+    COMMENT
+};
+
+/**
+ * Source that produces no token, kept so tools can rebuild the exact text
+ * Touching whitespace or new lines are merged into one entry
+ */
+struct Trivia {
+    std::uint64_t offset;
+    std::uint32_t length;
+    std::uint32_t token; // index of the token that follows, the token count for trailing trivia
+    TriviaKind kind;
+};
+
+/**
+ * Limits are off when 0, reaching one stops the lex early (see BasicLexer::getTruncation)
+ */
+struct LexerOptions {
+    bool keepTrivia = false; // fill getTrivia(), off by default as most callers only need tokens
+    bool keepSymbolIndex = false; // record identifier uses for buildSymbolIndex()
+    bool keepBracketMatches = false; // pair (), [] and {} for findMatchingBracket(), reporting unbalanced ones as errors
+
+    std::uint64_t maxBytes = 0; // bytes of source lexed until reset
+    std::size_t maxTokens = 0;
+    std::size_t maxErrors = 0;
+    std::chrono::milliseconds timeLimit { 0 }; // per buildTokens call, checked every few KiB
+};
+
+enum class LexerLimit : std::uint8_t {
+    BYTES,
+    TOKENS,
+    ERRORS,
+    TIME
+};
+
+/**
+ * Why and where a lex stopped early
+ * Tokens, errors and literals before offset are kept, the token being read there is dropped
+ */
+struct LexerTruncation {
+    LexerLimit limit;
+    std::uint64_t offset;
+};
+
+/**
+ * Where a BasicLexer puts what it finds, see LexerSinks.hpp
+ * Tokens and errors arrive in source order, value and message only live for the call
+ */
+template <class T>
+concept LexerSink = requires(T sink, const T& constSink, TokenType type, std::string_view text, std::uint64_t offset, std::uint32_t length, std::uint32_t symbol, std::size_t count) {
+    sink.saveToken(type, text, offset, length, symbol);
+    sink.saveError(text, text, offset); // message then detail
+    { constSink.getTokenCount() } -> std::convertible_to<std::size_t>;
+    { constSink.getErrorCount() } -> std::convertible_to<std::size_t>;
+    sink.truncate(count, count); // drops the tokens and errors past the counts
+    sink.flush(); // every few KiB of text and when buildTokens returns, after any truncate
+    sink.reset();
+};
+
+/**
+ * Side work done while lexing, chosen at compile time so a lexer without it has no trace of it in the loop
+ * LexerOptions still decide at run time for the work a feature allows
+ */
+struct LexerFeatures {
+    static constexpr bool hasComments = true; // getComments(), and comment trivia for keepTrivia
+    static constexpr bool hasTrivia = true; // whitespace trivia for keepTrivia
+    static constexpr bool hasSymbols = true; // identifiers interned into the symbol table, and keepSymbolIndex
+    static constexpr bool hasLiterals = true; // values of literal tokens, with their out of range errors
+    static constexpr bool hasBrackets = true; // keepBracketMatches
+};
+
+/**
+ * Tokens and errors only, for counting or checking text
+ */
+struct ScanFeatures {
+    static constexpr bool hasComments = false;
+    static constexpr bool hasTrivia = false;
+    static constexpr bool hasSymbols = false;
+    static constexpr bool hasLiterals = false;
+    static constexpr bool hasBrackets = false;
+};
+
+/**
+ * Everything that reports an error, for validating text without keeping tokens
+ */
+struct ValidationFeatures {
+    static constexpr bool hasComments = false;
+    static constexpr bool hasTrivia = false;
+    static constexpr bool hasSymbols = false;
+    static constexpr bool hasLiterals = true;
+    static constexpr bool hasBrackets = true;
+};
+
+/**
+ * The state machine of the lexer, passing what it finds to a sink
+ * Members are compiled in the lexer's .cpp files for the pairs of SPECULA_LEXER_INSTANCES (LexerSinks.hpp),
+ * a new pair is added there
+ */
+template <LexerSink Sink, class Features = LexerFeatures>
+class BasicLexer : protected LexerRuleset {
+public:
+    BasicLexer();
+
+    /**
+     * Clears state, sink and side tables
+     * Capacity is kept, so lexing similar text again does not allocate
+     */
+    void reset();
+
+    /**
+     * Setups tokens based on the text
+     * Offsets continue from the previous call until reset
+     * Text is UTF-8, malformed characters are reported as errors
+     *
+     * @param text Text to parse, usually a whole file
+     */
+    void buildTokens(std::string_view text);
+
+    Sink& getSink() { return mSink; }
+    const Sink& getSink() const { return mSink; }
+
+    /**
+     * Gets where the comments are, including their slashes, ordered by offset
+     * Comments produce no tokens
+     */
+    const std::vector<SourceRange>& getComments() const { return mComments; }
+
+    /**
+     * Gets the whitespace and comments, ordered by offset
+     * Empty unless LexerOptions::keepTrivia is set
+     */
+    const std::vector<Trivia>& getTrivia() const { return mTrivia; }
+
+    /**
+     * Gets the trivia between the token at the index and the one before it
+     * Pass the token count for the trivia after the last token
+     */
+    std::span<const Trivia> getTriviaBefore(std::size_t tokenIndex) const;
+
+    /**
+     * Builds the index of the identifier uses recorded while lexing
+     * Empty unless LexerOptions::keepSymbolIndex is set
+     */
+    SymbolIndex buildSymbolIndex() const { return SymbolIndex { mSymbolUses }; }
+
+    /**
+     * Gets the index of the delimiter paired with the one at the index, in either direction
+     * Empty for unbalanced delimiters, other tokens, or unless LexerOptions::keepBracketMatches is set
+     * Openings still open when buildTokens returns are reported as errors
+     */
+    std::optional<std::size_t> findMatchingBracket(std::size_t tokenIndex) const;
+
+    /**
+     * Set when a limit of the options was reached, buildTokens does nothing more until reset
+     */
+    const std::optional<LexerTruncation>& getTruncation() const { return mTruncation; }
+
+    /**
+     * Options apply from the next buildTokens call
+     */
+    void setOptions(const LexerOptions& options) { mOptions = options; }
+    const LexerOptions& getOptions() const { return mOptions; }
+
+    /**
+     * Gets the values of the literal tokens, ordered by token index
+     */
+    const std::vector<Literal>& getLiterals() const { return mLiterals; }
+
+    /**
+     * Gets the value of the token at the index, if it is a literal with one
+     */
+    const Literal* findLiteral(std::size_t tokenIndex) const;
+
+    /**
+     * Uses another symbol table for identifiers, eg. one shared by every file in a run
+     * Ids already stored in tokens refer to the previous table
+     */
+    void setSymbolTable(std::shared_ptr<SymbolTable> symbols) { mSymbols = std::move(symbols); }
+
+    /**
+     * Gets the table that the symbol ids of IDENT tokens refer to
+     */
+    const SymbolTable& getSymbolTable() const { return *mSymbols; }
+
+private:
+    // An opening delimiter not closed yet
+    struct OpenBracket {
+        std::uint32_t token;
+        TokenType type;
+        std::uint64_t offset;
+    };
+
+    Sink mSink;
+
+    LexerState mCurrentState;
+    char mToRead;
+    bool mIsInvalidByte = false; // mToRead starts a malformed UTF-8 character
+    std::string mLexeme; // to be appended by build tokens
+
+    std::uint64_t mOffset; // offset of mToRead in the source
+    std::uint64_t mTokenStart;
+    std::uint64_t mTokenEnd; // one past the last character consumed by the token
+
+    std::vector<Literal> mLiterals;
+    std::vector<SourceRange> mComments;
+    std::vector<Trivia> mTrivia;
+    std::vector<SymbolUse> mSymbolUses; // in token order
+    std::vector<std::uint32_t> mBracketMatches; // by token index, mNoMatch past the end and for unpaired tokens
+    std::vector<OpenBracket> mOpenBrackets; // innermost last
+    LexerOptions mOptions;
+    std::optional<LexerTruncation> mTruncation;
+    std::shared_ptr<SymbolTable> mSymbols;
+
+    static constexpr std::uint32_t mNoMatch = UINT32_MAX;
+
+    enum class HandleStateResult {
+        CONTINUE,
+        REPROCESS // When handleState doesn't store the character to the lexeme (mainly for exiting states)
+    };
+
+    // Calls respective state functions
+    HandleStateResult handleState();
+
+    void resetState();
+    // Calls when no string is being read
+    void flushLeftoverLexeme();
+
+    // State functions
+    HandleStateResult handleStartState();
+    HandleStateResult handleInvalidState();
+    HandleStateResult handleDelimeterState();
+    HandleStateResult handleExpectDelimeterState();
+    HandleStateResult handleIdentifierState();
+    HandleStateResult handleIdentifierDashState();
+
+    HandleStateResult handleNumStartState();
+    HandleStateResult handleDecimalState();
+    HandleStateResult handleFloatState();
+    HandleStateResult handleCharStartState();
+    HandleStateResult handleCharEndState();
+    HandleStateResult handleCharEscapeCharState();
+    HandleStateResult handleStringState();
+    HandleStateResult handleStringEscapeCharState();
+
+    HandleStateResult handleOpState();
+    HandleStateResult handleOpEqualsNextState();
+    HandleStateResult handleIncrementableState();
+    HandleStateResult handleOpLogicalState();
+    HandleStateResult handleOpMinusState();
+    HandleStateResult handleOpLessThanState();
+    HandleStateResult handleOpGreaterThanState();
+    HandleStateResult handleOpLeftArrowState();
+
+    HandleStateResult handleCharSlashState();
+    HandleStateResult handleCommentState();
+    HandleStateResult handleMultilineCommentState();
+    HandleStateResult handleMultilineCommentEndState();
+
+    /// Helper functions
+    // Passes mLexeme to the sink as a token and records what it adds to the side tables
+    void saveToken(TokenType type);
+    // Passes one token to the sink, interning identifiers
+    void emitToken(TokenType type, std::string_view value, std::uint64_t offset, std::uint32_t length);
+    // Adds an error whose message is message followed by detail
+    void saveError(std::string_view message, std::uint64_t offset, std::string_view detail = {});
+    // Stops lexing, keeping only what is complete
+    void truncate(LexerLimit limit);
+    // Records the comment from mTokenStart up to end
+    void saveComment(std::uint64_t end);
+    // Records a trivia range before the next token, only called when keeping trivia
+    void saveTrivia(TriviaKind kind, std::uint64_t offset, std::uint32_t length);
+    // Adds the token just saved to the symbol uses, only called when keeping the symbol index
+    void recordSymbolUse(std::uint32_t symbol);
+    // Pairs the delimiter just saved with its opening, only called when keeping bracket matches
+    void matchBracket(TokenType type);
+    // Reports the openings left on the stack and empties it
+    void closeOpenBrackets();
+    // Stores the value of the token just saved from mLexeme, if it is a literal
+    void recordLiteral(TokenType type);
+    // Adds to mLexeme and marks mToRead as part of the token
+    void appendLexeme(char c);
+
+    // Used for throwing an error
+    HandleStateResult setStateInvalid(std::string_view message, std::string_view detail = {});
+
+    bool isValidIdentifier(char c);
+    void finalizeIdentifier();
+    void finalizeIdentifierDash();
+};
@@ -0,0 +1,116 @@
+#include "BatchLexer.hpp"
+#include <algorithm>
+#include <iterator>
+#include <thread>
+
+std::span<const Token> BatchResult::getTokens(std::size_t item) const
+{
+    return std::span<const Token>(tokens).subspan(tokenOffsets[item], tokenOffsets[item + 1] - tokenOffsets[item]);
+}
+
+std::span<const ErrorLines> BatchResult::getErrors(std::size_t item) const
+{
+    return std::span<const ErrorLines>(errors).subspan(errorOffsets[item], errorOffsets[item + 1] - errorOffsets[item]);
+}
+
+void BatchResult::clear()
+{
+    tokens.clear();
+    errors.clear();
+    literals.clear();
+    tokenOffsets.assign(1, 0);
+    errorOffsets.assign(1, 0);
+}
+
+BatchLexer::BatchLexer(unsigned int threadCount, std::size_t parallelBytes)
+    : mThreadCount(threadCount == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threadCount)
+    , mParallelBytes(parallelBytes)
+    , mSymbols(std::make_shared<SymbolTable>())
+{
+    mResult.clear();
+}
+
+BatchLexer::Worker& BatchLexer::getWorker(std::size_t index)
+{
+    while (mWorkers.size() <= index) {
+        auto worker = std::make_unique<Worker>();
+        worker->lexer.setSymbolTable(mSymbols);
+        mWorkers.push_back(std::move(worker));
+    }
+    return *mWorkers[index];
+}
+
+void BatchLexer::lexShard(LexicalAnalyzer& lexer, std::span<const std::string_view> sources, BatchResult& out)
+{
+    out.clear();
+    for (std::string_view source : sources) {
+        lexer.reset();
+        lexer.buildTokens(source);
+        lexer.appendResultsTo(out.tokens, out.errors, out.literals);
+        out.tokenOffsets.push_back(out.tokens.size());
+        out.errorOffsets.push_back(out.errors.size());
+    }
+}
+
+const BatchResult& BatchLexer::lex(std::span<const std::string_view> sources)
+{
+    std::size_t totalBytes = 0;
+    for (std::string_view source : sources) {
+        totalBytes += source.size();
+    }
+
+    std::size_t workerCount = 1;
+    if (totalBytes >= mParallelBytes) {
+        workerCount = std::min<std::size_t>(mThreadCount, sources.size());
+    }
+    if (workerCount <= 1) {
+        lexShard(getWorker(0).lexer, sources, mResult);
+        return mResult;
+    }
+
+    // Contiguous shards of about the same number of bytes, so the output keeps the input order
+    std::vector<std::span<const std::string_view>> shards;
+    std::size_t shardStart = 0;
+    std::size_t shardBytes = 0;
+    std::size_t bytesPerShard = totalBytes / workerCount + 1;
+    for (std::size_t i = 0; i < sources.size(); i++) {
+        shardBytes += sources[i].size();
+        if (shardBytes >= bytesPerShard && shards.size() + 1 < workerCount) {
+            shards.push_back(sources.subspan(shardStart, i + 1 - shardStart));
+            shardStart = i + 1;
+            shardBytes = 0;
+        }
+    }
+    shards.push_back(sources.subspan(shardStart));
+
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(shards.size() - 1);
+        for (std::size_t i = 1; i < shards.size(); i++) {
+            Worker& worker = getWorker(i);
+            threads.emplace_back([&worker, shard = shards[i]] {
+                lexShard(worker.lexer, shard, worker.shard);
+            });
+        }
+        Worker& worker = getWorker(0);
+        lexShard(worker.lexer, shards[0], worker.shard);
+    }
+
+    mResult.clear();
+    for (std::size_t i = 0; i < shards.size(); i++) {
+        BatchResult& shard = mWorkers[i]->shard;
+        std::size_t tokenBase = mResult.tokens.size();
+        std::size_t errorBase = mResult.errors.size();
+        std::ranges::move(shard.tokens, std::back_inserter(mResult.tokens));
+        std::ranges::move(shard.errors, std::back_inserter(mResult.errors));
+        for (Literal& literal : shard.literals) {
+            literal.token += static_cast<std::uint32_t>(tokenBase);
+            mResult.literals.push_back(literal);
+        }
+        for (std::size_t item = 1; item < shard.tokenOffsets.size(); item++) {
+            mResult.tokenOffsets.push_back(tokenBase + shard.tokenOffsets[item]);
+            mResult.errorOffsets.push_back(errorBase + shard.errorOffsets[item]);
+        }
+    }
+    return mResult;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "ErrorLines.hpp"
+#include "LexicalAnalyzer.hpp"
+#include "SymbolTable.hpp"
+
+/**
+ * Tokens and errors of many sources stored back to back
+ * Item i owns tokens [tokenOffsets[i], tokenOffsets[i + 1]), errors likewise
+ * Token and error offsets are relative to the item's own source
+ */
+struct BatchResult {
+    std::vector<Token> tokens;
+    std::vector<ErrorLines> errors;
+    std::vector<Literal> literals; // token indices point into tokens
+    std::vector<std::size_t> tokenOffsets;
+    std::vector<std::size_t> errorOffsets;
+
+    std::size_t size() const { return tokenOffsets.empty() ? 0 : tokenOffsets.size() - 1; }
+    std::span<const Token> getTokens(std::size_t item) const;
+    std::span<const ErrorLines> getErrors(std::size_t item) const;
+
+    // Empties the result but keeps its capacity
+    void clear();
+};
+
+/**
+ * Lexes many small sources in one call
+ * Lexers and buffers are kept between calls, large batches are split across threads
+ */
+class BatchLexer {
+public:
+    /**
+     * @param threadCount Most threads used for one batch
+     * @param parallelBytes Batches smaller than this are lexed on the calling thread
+     */
+    explicit BatchLexer(unsigned int threadCount = 0, std::size_t parallelBytes = 1 << 20);
+
+    /**
+     * Lexes every source, the result is valid until the next call
+     */
+    const BatchResult& lex(std::span<const std::string_view> sources);
+
+    const BatchResult& getResult() const { return mResult; }
+    const SymbolTable& getSymbolTable() const { return *mSymbols; }
+
+private:
+    struct Worker {
+        LexicalAnalyzer lexer;
+        BatchResult shard;
+    };
+
+    unsigned int mThreadCount;
+    std::size_t mParallelBytes;
+    std::shared_ptr<SymbolTable> mSymbols; // shared by every worker so ids match across items
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    BatchResult mResult;
+
+    Worker& getWorker(std::size_t index);
+    static void lexShard(LexicalAnalyzer& lexer, std::span<const std::string_view> sources, BatchResult& out);
+};
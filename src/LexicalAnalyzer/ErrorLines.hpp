@@ -1,10 +1,9 @@
 #pragma once
 
-#include <nlohmann/json.hpp>
+#include <cstdint>
 #include <string>
 
 struct ErrorLines {
     std::string message;
-    int charPos;
-    int line;
+    std::uint64_t offset; // byte offset in the source, see LineIndex for the line
 };
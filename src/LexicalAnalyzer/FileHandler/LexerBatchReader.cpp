@@ -0,0 +1,29 @@
+#include "LexerBatchReader.hpp"
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+#include <string_view>
+
+LexerBatchReader::LexerBatchReader(BatchLexer& lexer, const std::string& filePath)
+    : mLexer(lexer)
+{
+    std::ifstream readFile { filePath };
+    if (!readFile.is_open()) {
+        throw std::invalid_argument("Cannot open file: " + filePath);
+    }
+
+    nlohmann::json input = nlohmann::json::parse(readFile, nullptr, false);
+    if (!input.is_array()) {
+        throw std::invalid_argument("Batch file is not a JSON array of sources: " + filePath);
+    }
+    mSources.reserve(input.size());
+    for (nlohmann::json& source : input) {
+        if (!source.is_string()) {
+            throw std::invalid_argument("Batch file is not a JSON array of sources: " + filePath);
+        }
+        mSources.push_back(std::move(source.get_ref<std::string&>()));
+    }
+
+    std::vector<std::string_view> views { mSources.begin(), mSources.end() };
+    lexer.lex(views);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "BatchLexer.hpp"
+#include <string>
+#include <vector>
+
+/**
+ * Reads a JSON array of sources and lexes them as one batch
+ * Automatically builds tokens on construct
+ */
+class LexerBatchReader {
+public:
+    /**
+     * @throws std::invalid_argument if the file cannot be opened or is not an array of strings
+     */
+    LexerBatchReader(BatchLexer& lexer, const std::string& filePath);
+
+    const std::vector<std::string>& getSources() const { return mSources; }
+
+private:
+    const BatchLexer& mLexer;
+
+    std::vector<std::string> mSources;
+};
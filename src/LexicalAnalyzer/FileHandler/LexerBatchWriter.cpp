@@ -0,0 +1,39 @@
+#include "LexerBatchWriter.hpp"
+#include "LexerFileWriter.hpp"
+#include "LineIndex.hpp"
+#include <filesystem>
+#include <fstream>
+
+LexerBatchWriter::LexerBatchWriter(const BatchLexer& lexer, const std::vector<std::string>& sources, const std::string& filePath)
+    : mLexer(lexer)
+{
+    const BatchResult& result = lexer.getResult();
+    std::filesystem::path inputPath { filePath };
+    std::ofstream writeFile { LexerFileWriter::getOutputPath(filePath) };
+    mOutput["file"] = {
+        {"name", inputPath.stem().string()},
+        {"type", "specula_batch"}
+    };
+
+    nlohmann::json& errors = mOutput["errors"] = nlohmann::json::array();
+    nlohmann::json& tokens = mOutput["tokens"] = nlohmann::json::array();
+    for (std::size_t item = 0; item < result.size(); item++) {
+        LineIndex lines { sources[item] };
+        for (const ErrorLines& error : result.getErrors(item)) {
+            errors.push_back(errorToJson(error, lines));
+        }
+        for (const Token& token : result.getTokens(item)) {
+            tokens.push_back(tokenToJson(token, lines));
+        }
+    }
+    nlohmann::json& literals = mOutput["literals"] = nlohmann::json::array();
+    for (const Literal& literal : result.literals) {
+        literals.push_back(literalToJson(literal, result.tokens[literal.token]));
+    }
+    mOutput["token_offsets"] = result.tokenOffsets;
+    mOutput["error_offsets"] = result.errorOffsets;
+    mOutput["symbols"] = lexer.getSymbolTable().getNames();
+    writeFile << dumpJson(mOutput, 4);
+
+    writeFile.close();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "BatchLexer.hpp"
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * Used for writing the result of a batch to the file
+ * Tokens and errors of every item are written in one array each, split by "token_offsets" and "error_offsets"
+ */
+class LexerBatchWriter {
+public:
+    LexerBatchWriter(const BatchLexer& lexer, const std::vector<std::string>& sources, const std::string& filePath);
+
+private:
+    const BatchLexer& mLexer;
+    nlohmann::json mOutput;
+};
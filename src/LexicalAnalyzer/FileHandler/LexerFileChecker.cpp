@@ -0,0 +1,84 @@
+#include "LexerFileChecker.hpp"
+#include "LexerFileReader.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+LexerFileChecker::LexerFileChecker(const LexerOptions& options, unsigned int threadCount)
+    : mOptions(options)
+    , mThreadCount(threadCount == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threadCount)
+{
+}
+
+void LexerFileChecker::checkFile(ValidatingLexer& lexer, FileCheck& result) const
+{
+    TraceSpan span { "file", result.path };
+    std::expected<std::string, LexFailure> source = LexerFileReader::readSource(result.path, mOptions.maxBytes);
+    if (!source.has_value()) {
+        result.failure = source.error();
+        return;
+    }
+    lexer.reset();
+    lexer.buildTokens(*source);
+
+    const std::optional<LexerTruncation>& truncation = lexer.getTruncation();
+    // Stopping at an error count still found errors, any other limit leaves the rest of the file unchecked
+    if (truncation.has_value() && truncation->limit != LexerLimit::ERRORS) {
+        result.failure = LexFailure { LexFailureKind::LIMIT, truncation };
+    }
+    std::span<const ErrorLines> errors = lexer.getSink().getErrors();
+    if (errors.empty()) {
+        return;
+    }
+    // Most files have no error, so the lines are only found for those that do
+    LineIndex lines { *source };
+    for (const ErrorLines& error : errors) {
+        result.errors.push_back({ error.message, error.offset, lines.getPosition(error.offset) });
+    }
+}
+
+const std::vector<FileCheck>& LexerFileChecker::check(std::span<const std::string> files)
+{
+    mResults.clear();
+    mResults.resize(files.size());
+    for (std::size_t i = 0; i < files.size(); i++) {
+        mResults[i].path = files[i];
+    }
+
+    LexerOptions options = mOptions;
+    if (!mIsCollectingAll) {
+        options.maxErrors = 1;
+    }
+    // Files vary a lot in size, taking them one at a time keeps every thread busy until the end
+    std::atomic<std::size_t> next { 0 };
+    auto work = [&] {
+        ValidatingLexer lexer;
+        lexer.setOptions(options);
+        for (std::size_t i = next.fetch_add(1, std::memory_order_relaxed); i < mResults.size(); i = next.fetch_add(1, std::memory_order_relaxed)) {
+            checkFile(lexer, mResults[i]);
+        }
+    };
+
+    {
+        std::size_t threadCount = std::min<std::size_t>(mThreadCount, std::max<std::size_t>(files.size(), 1));
+        std::vector<std::jthread> threads;
+        threads.reserve(threadCount - 1);
+        for (std::size_t i = 1; i < threadCount; i++) {
+            threads.emplace_back(work);
+        }
+        work();
+    }
+    return mResults;
+}
+
+int LexerFileChecker::getExitCode() const
+{
+    if (std::ranges::any_of(mResults, [](const FileCheck& result) { return result.failure.has_value(); })) {
+        return 2;
+    }
+    if (std::ranges::any_of(mResults, [](const FileCheck& result) { return !result.errors.empty(); })) {
+        return 1;
+    }
+    return 0;
+}
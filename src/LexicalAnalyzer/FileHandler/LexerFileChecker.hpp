@@ -0,0 +1,60 @@
+#pragma once
+
+#include "LexerSinks.hpp"
+#include "LexicalAnalyzer.hpp"
+#include "LineIndex.hpp"
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+struct CheckError {
+    std::string message;
+    std::uint64_t offset;
+    SourcePosition position;
+};
+
+/**
+ * Errors of one checked file
+ */
+struct FileCheck {
+    std::string path;
+    std::vector<CheckError> errors; // only the first one unless every error is collected
+    std::optional<LexFailure> failure; // the file could not be read, or a limit other than the error count cut it
+};
+
+/**
+ * Lexes files only for their errors, for pre-commit hooks and CI
+ * No token is stored and nothing is written, each thread reuses one ValidatingLexer for the files it takes
+ */
+class LexerFileChecker {
+public:
+    /**
+     * @param threadCount Threads checking files at once, 0 for one per core
+     */
+    explicit LexerFileChecker(const LexerOptions& options = {}, unsigned int threadCount = 0);
+
+    /**
+     * Off by default, each file then stops at its first error
+     */
+    void setCollectingAllErrors(bool isCollectingAll) { mIsCollectingAll = isCollectingAll; }
+
+    /**
+     * Checks the files, results are in the order of the files and valid until the next call
+     */
+    const std::vector<FileCheck>& check(std::span<const std::string> files);
+
+    /**
+     * 0 when every file was checked without errors, 1 when one has errors, 2 when one could not be checked
+     */
+    int getExitCode() const;
+
+private:
+    LexerOptions mOptions;
+    unsigned int mThreadCount;
+    bool mIsCollectingAll = false;
+    std::vector<FileCheck> mResults;
+
+    void checkFile(ValidatingLexer& lexer, FileCheck& result) const;
+};
@@ -0,0 +1,560 @@
+#include "LexerFilePipeline.hpp"
+#include "LexerFileReader.hpp"
+#include "LexerFileWriter.hpp"
+#include "LineIndex.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <semaphore>
+#include <thread>
+#include <utility>
+
+#if SPECULA_HAS_IO_URING
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define SPECULA_USE_IO_URING 1
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace {
+
+template <typename T>
+class BlockingQueue {
+public:
+    void push(T value)
+    {
+        {
+            std::lock_guard lock { mMutex };
+            mItems.push_back(std::move(value));
+        }
+        mCondition.notify_one();
+    }
+
+    // Gives nothing once the queue is closed and empty
+    std::optional<T> pop()
+    {
+        std::unique_lock lock { mMutex };
+        mCondition.wait(lock, [this] { return !mItems.empty() || mIsClosed; });
+        if (mItems.empty()) {
+            return std::nullopt;
+        }
+        T value = std::move(mItems.front());
+        mItems.pop_front();
+        return value;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard lock { mMutex };
+            mIsClosed = true;
+        }
+        mCondition.notify_all();
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<T> mItems;
+    bool mIsClosed = false;
+};
+
+/**
+ * Blocking reads on one thread and blocking writes on another
+ */
+class ThreadIo : public LexerFilePipeline::Io {
+public:
+    explicit ThreadIo(std::size_t depth)
+        : mDepth(static_cast<std::ptrdiff_t>(depth))
+        , mWriteSlots(mDepth)
+        , mReader([this] { readLoop(); })
+        , mWriter([this] { writeLoop(); })
+    {
+    }
+
+    ~ThreadIo() override
+    {
+        mReadRequests.close();
+        mWriteRequests.close();
+    }
+
+    void startRead(const std::string& path) override
+    {
+        mReadRequests.push(path);
+    }
+
+    ReadResult waitRead() override
+    {
+        return mReadResults.pop().value();
+    }
+
+    void startWrite(const std::filesystem::path& path, std::string data) override
+    {
+        mWriteSlots.acquire();
+        mWriteRequests.push({ path, std::move(data) });
+    }
+
+    std::vector<std::string> finish() override
+    {
+        // Every slot is free once the writer is idle
+        for (std::ptrdiff_t i = 0; i < mDepth; i++) {
+            mWriteSlots.acquire();
+        }
+        mWriteSlots.release(mDepth);
+
+        std::lock_guard lock { mErrorsMutex };
+        return std::exchange(mWriteErrors, {});
+    }
+
+private:
+    struct WriteRequest {
+        std::filesystem::path path;
+        std::string data;
+    };
+
+    std::ptrdiff_t mDepth;
+    std::counting_semaphore<> mWriteSlots;
+    BlockingQueue<std::string> mReadRequests;
+    BlockingQueue<ReadResult> mReadResults;
+    BlockingQueue<WriteRequest> mWriteRequests;
+    std::mutex mErrorsMutex;
+    std::vector<std::string> mWriteErrors;
+
+    // Declared last so they are joined before the queues are destroyed
+    std::jthread mReader;
+    std::jthread mWriter;
+
+    void readLoop()
+    {
+        while (std::optional<std::string> path = mReadRequests.pop()) {
+            ReadResult result;
+            std::expected<std::string, LexFailure> source = LexerFileReader::readSource(*path, 0);
+            if (source.has_value()) {
+                result.data = std::move(*source);
+            } else {
+                bool isOpenError = source.error().kind == LexFailureKind::CANNOT_OPEN;
+                result.error = (isOpenError ? "Cannot open file: " : "Cannot read file: ") + *path;
+            }
+            mReadResults.push(std::move(result));
+        }
+    }
+
+    void writeLoop()
+    {
+        while (std::optional<WriteRequest> request = mWriteRequests.pop()) {
+            std::ofstream writeFile { request->path, std::ios::binary };
+            writeFile << request->data;
+            writeFile.close();
+            if (!writeFile) {
+                std::lock_guard lock { mErrorsMutex };
+                mWriteErrors.push_back("Cannot write file: " + request->path.string());
+            }
+            mWriteSlots.release();
+        }
+    }
+};
+
+#if SPECULA_USE_IO_URING
+
+/**
+ * Reads and writes through an io_uring submission queue, all from the calling thread
+ * Files are opened synchronously, the data transfer is asynchronous
+ */
+class IoUringIo : public LexerFilePipeline::Io {
+public:
+    // Gives nothing when the kernel does not allow io_uring (eg. blocked in a container)
+    static std::unique_ptr<IoUringIo> create(std::size_t depth)
+    {
+        unsigned int entries = std::bit_ceil(static_cast<unsigned int>(depth * 2 + 2));
+        io_uring_params params {};
+        int ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd < 0) {
+            return nullptr;
+        }
+        auto io = std::unique_ptr<IoUringIo>(new IoUringIo(ringFd, depth));
+        if (!io->mapRings(params)) {
+            return nullptr;
+        }
+        return io;
+    }
+
+    ~IoUringIo() override
+    {
+        // The kernel may still write into buffers owned by pending operations, abandoned ones are only freed after the ring is closed
+        while (hasPendingOperations()) {
+            reap(true);
+        }
+        if (mSqRing != MAP_FAILED) {
+            munmap(mSqRing, mSqRingSize);
+        }
+        if (mCqRing != MAP_FAILED) {
+            munmap(mCqRing, mCqRingSize);
+        }
+        if (mSqes != MAP_FAILED) {
+            munmap(mSqes, mSqesSize);
+        }
+        close(mRingFd);
+    }
+
+    void startRead(const std::string& path) override
+    {
+        Operation& operation = *mReads.emplace_back(std::make_unique<Operation>());
+        operation.path = path;
+        operation.fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (operation.fd < 0) {
+            operation.error = "Cannot open file: " + path;
+            operation.isComplete = true;
+            return;
+        }
+        struct stat fileStat {};
+        if (fstat(operation.fd, &fileStat) != 0 || !mRingError.empty()) {
+            operation.error = describeFailure(operation);
+            completeOperation(operation);
+            return;
+        }
+        operation.data.resize(static_cast<std::size_t>(fileStat.st_size));
+        if (operation.data.empty()) {
+            completeOperation(operation);
+            return;
+        }
+        queueOperation(operation);
+        submit(0);
+    }
+
+    ReadResult waitRead() override
+    {
+        // Looked up again after each reap, a failing ring replaces the operation
+        while (!mReads.front()->isComplete) {
+            reap(true);
+        }
+        Operation& front = *mReads.front();
+        ReadResult result { std::move(front.data), std::move(front.error) };
+        mReads.pop_front();
+        return result;
+    }
+
+    void startWrite(const std::filesystem::path& path, std::string data) override
+    {
+        while (mWrites.size() >= mDepth) {
+            reap(true);
+        }
+        auto operation = std::make_unique<Operation>();
+        operation->isWrite = true;
+        operation->path = path.string();
+        operation->data = std::move(data);
+        operation->fd = open(operation->path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (operation->fd < 0) {
+            mWriteErrors.push_back("Cannot write file: " + operation->path);
+            return;
+        }
+        Operation& queued = *mWrites.emplace_back(std::move(operation));
+        if (!mRingError.empty()) {
+            queued.error = describeFailure(queued);
+        }
+        if (queued.data.empty() || !mRingError.empty()) {
+            completeOperation(queued);
+            return;
+        }
+        queueOperation(queued);
+        submit(0);
+    }
+
+    std::vector<std::string> finish() override
+    {
+        while (!mWrites.empty()) {
+            reap(true);
+        }
+        return std::exchange(mWriteErrors, {});
+    }
+
+private:
+    struct Operation {
+        bool isWrite = false;
+        bool isComplete = false;
+        int fd = -1;
+        std::string path;
+        std::string data;
+        std::size_t done = 0;
+        std::string error;
+        iovec buffer {};
+    };
+
+    int mRingFd;
+    std::size_t mDepth;
+
+    void* mSqRing = MAP_FAILED;
+    void* mCqRing = MAP_FAILED;
+    void* mSqes = MAP_FAILED;
+    std::size_t mSqRingSize = 0;
+    std::size_t mCqRingSize = 0;
+    std::size_t mSqesSize = 0;
+
+    unsigned int* mSqHead = nullptr;
+    unsigned int* mSqTail = nullptr;
+    unsigned int* mSqMask = nullptr;
+    unsigned int* mSqEntries = nullptr;
+    unsigned int* mSqArray = nullptr;
+    unsigned int* mCqHead = nullptr;
+    unsigned int* mCqTail = nullptr;
+    unsigned int* mCqMask = nullptr;
+    io_uring_cqe* mCqes = nullptr;
+    unsigned int mSqLocalTail = 0;
+    unsigned int mToSubmit = 0;
+
+    std::deque<std::unique_ptr<Operation>> mReads; // in the order they were started
+    std::vector<std::unique_ptr<Operation>> mWrites; // in flight
+    std::vector<std::string> mWriteErrors;
+    std::string mRingError; // set when io_uring_enter failed, no operation is queued after that
+    std::vector<std::unique_ptr<Operation>> mAbandoned; // in flight when the ring failed
+
+    std::string describeFailure(const Operation& operation) const
+    {
+        std::string message = (operation.isWrite ? "Cannot write file: " : "Cannot read file: ") + operation.path;
+        return mRingError.empty() ? message : message + " (io_uring: " + mRingError + ")";
+    }
+
+    IoUringIo(int ringFd, std::size_t depth)
+        : mRingFd(ringFd)
+        , mDepth(depth)
+    {
+    }
+
+    bool mapRings(const io_uring_params& params)
+    {
+        mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+        mCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        mSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        mSqRing = mmap(nullptr, mSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_SQ_RING);
+        mCqRing = mmap(nullptr, mCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_CQ_RING);
+        mSqes = mmap(nullptr, mSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_SQES);
+        if (mSqRing == MAP_FAILED || mCqRing == MAP_FAILED || mSqes == MAP_FAILED) {
+            return false;
+        }
+
+        char* sqRing = static_cast<char*>(mSqRing);
+        mSqHead = reinterpret_cast<unsigned int*>(sqRing + params.sq_off.head);
+        mSqTail = reinterpret_cast<unsigned int*>(sqRing + params.sq_off.tail);
+        mSqMask = reinterpret_cast<unsigned int*>(sqRing + params.sq_off.ring_mask);
+        mSqEntries = reinterpret_cast<unsigned int*>(sqRing + params.sq_off.ring_entries);
+        mSqArray = reinterpret_cast<unsigned int*>(sqRing + params.sq_off.array);
+        char* cqRing = static_cast<char*>(mCqRing);
+        mCqHead = reinterpret_cast<unsigned int*>(cqRing + params.cq_off.head);
+        mCqTail = reinterpret_cast<unsigned int*>(cqRing + params.cq_off.tail);
+        mCqMask = reinterpret_cast<unsigned int*>(cqRing + params.cq_off.ring_mask);
+        mCqes = reinterpret_cast<io_uring_cqe*>(cqRing + params.cq_off.cqes);
+        mSqLocalTail = *mSqTail;
+        return true;
+    }
+
+    bool hasPendingOperations() const
+    {
+        bool hasPendingRead = std::ranges::any_of(mReads, [](const auto& operation) { return !operation->isComplete; });
+        return hasPendingRead || !mWrites.empty();
+    }
+
+    // Adds a read or write of the remaining bytes to the submission queue
+    // Callers check the ring has not failed, if it fails while waiting for room the operation is failed with the others
+    void queueOperation(Operation& operation)
+    {
+        while (mSqLocalTail - std::atomic_ref(*mSqHead).load(std::memory_order_acquire) >= *mSqEntries) {
+            submit(0);
+            if (!mRingError.empty()) {
+                return;
+            }
+        }
+        unsigned int index = mSqLocalTail & *mSqMask;
+        io_uring_sqe& sqe = static_cast<io_uring_sqe*>(mSqes)[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+
+        operation.buffer = { operation.data.data() + operation.done, operation.data.size() - operation.done };
+        sqe.opcode = operation.isWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe.fd = operation.fd;
+        sqe.addr = reinterpret_cast<std::uint64_t>(&operation.buffer);
+        sqe.len = 1;
+        sqe.off = operation.done;
+        sqe.user_data = reinterpret_cast<std::uint64_t>(&operation);
+
+        mSqArray[index] = index;
+        mSqLocalTail++;
+        mToSubmit++;
+    }
+
+    // Hands queued entries to the kernel, waiting for at least waitFor completions
+    // Any error but an interrupt fails the ring, retrying it could wait forever
+    void submit(unsigned int waitFor)
+    {
+        if (!mRingError.empty()) {
+            return;
+        }
+        std::atomic_ref(*mSqTail).store(mSqLocalTail, std::memory_order_release);
+        if (mToSubmit == 0 && waitFor == 0) {
+            return;
+        }
+        unsigned int flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+        long submitted = syscall(__NR_io_uring_enter, mRingFd, mToSubmit, waitFor, flags, nullptr, 0);
+        while (submitted < 0 && errno == EINTR) {
+            submitted = syscall(__NR_io_uring_enter, mRingFd, mToSubmit, waitFor, flags, nullptr, 0);
+        }
+        if (submitted < 0) {
+            failRing(errno);
+            return;
+        }
+        mToSubmit -= static_cast<unsigned int>(submitted);
+    }
+
+    // Fails every operation not complete yet, each later one fails when it starts
+    void failRing(int error)
+    {
+        mRingError = std::strerror(error);
+        for (std::unique_ptr<Operation>& read : mReads) {
+            if (read->isComplete) {
+                continue;
+            }
+            // The kernel may still fill the buffer, so the waiting read gets another operation with the error
+            auto failed = std::make_unique<Operation>();
+            failed->path = read->path;
+            failed->error = describeFailure(*read);
+            failed->isComplete = true;
+            close(read->fd);
+            mAbandoned.push_back(std::exchange(read, std::move(failed)));
+        }
+        for (std::unique_ptr<Operation>& write : mWrites) {
+            mWriteErrors.push_back(describeFailure(*write));
+            close(write->fd);
+            mAbandoned.push_back(std::move(write));
+        }
+        mWrites.clear();
+    }
+
+    void reap(bool wait)
+    {
+        submit(wait ? 1 : 0);
+        if (!mRingError.empty()) {
+            return;
+        }
+        unsigned int head = *mCqHead;
+        unsigned int tail = std::atomic_ref(*mCqTail).load(std::memory_order_acquire);
+        for (; head != tail; head++) {
+            const io_uring_cqe& cqe = mCqes[head & *mCqMask];
+            onCompletion(*reinterpret_cast<Operation*>(cqe.user_data), cqe.res);
+        }
+        std::atomic_ref(*mCqHead).store(head, std::memory_order_release);
+    }
+
+    void onCompletion(Operation& operation, int result)
+    {
+        // Once the ring failed, completions are only for abandoned operations
+        if (!mRingError.empty()) {
+            return;
+        }
+        if (result == -EINTR || result == -EAGAIN) {
+            queueOperation(operation);
+            return;
+        }
+        if (result < 0 || (result == 0 && operation.isWrite)) {
+            operation.error = (operation.isWrite ? "Cannot write file: " : "Cannot read file: ") + operation.path;
+            completeOperation(operation);
+            return;
+        }
+        if (result == 0) {
+            // The file got shorter since it was opened
+            operation.data.resize(operation.done);
+            completeOperation(operation);
+            return;
+        }
+
+        operation.done += static_cast<std::size_t>(result);
+        if (operation.done < operation.data.size()) {
+            queueOperation(operation);
+            return;
+        }
+        completeOperation(operation);
+    }
+
+    void completeOperation(Operation& operation)
+    {
+        close(operation.fd);
+        operation.isComplete = true;
+        if (!operation.isWrite) {
+            return;
+        }
+        if (!operation.error.empty()) {
+            mWriteErrors.push_back(operation.error);
+        }
+        std::erase_if(mWrites, [&operation](const auto& write) { return write.get() == &operation; });
+    }
+};
+
+#endif
+
+}
+
+LexerFilePipeline::LexerFilePipeline(LexicalAnalyzer& lexer, std::size_t depth, bool useIoUring)
+    : mLexer(lexer)
+    , mDepth(std::max<std::size_t>(depth, 1))
+    , mIsUsingIoUring(false)
+{
+#if SPECULA_USE_IO_URING
+    if (useIoUring) {
+        mIo = IoUringIo::create(mDepth);
+        mIsUsingIoUring = mIo != nullptr;
+    }
+#else
+    (void)useIoUring;
+#endif
+    if (mIo == nullptr) {
+        mIo = std::make_unique<ThreadIo>(mDepth);
+    }
+}
+
+LexerFilePipeline::~LexerFilePipeline() = default;
+
+void LexerFilePipeline::run(const std::vector<std::string>& files, const std::function<void(const std::string&)>& onError)
+{
+    std::size_t nextRead = 0;
+    for (; nextRead < files.size() && nextRead < mDepth; nextRead++) {
+        mIo->startRead(files[nextRead]);
+    }
+
+    for (const std::string& file : files) {
+        Io::ReadResult read = mIo->waitRead();
+        if (nextRead < files.size()) {
+            mIo->startRead(files[nextRead++]);
+        }
+        if (!read.error.empty()) {
+            onError(read.error);
+            continue;
+        }
+
+        auto lexStart = std::chrono::steady_clock::now();
+        mLexer.reset();
+        mLexer.buildTokens(read.data);
+        if (mMetrics != nullptr) {
+            mMetrics->record(LexSample::of(mLexer, read.data.size(), std::chrono::steady_clock::now() - lexStart));
+        }
+        if (!mLexer.getTokens().empty()) {
+            LineIndex lines { read.data };
+            mIo->startWrite(LexerFileWriter::getOutputPath(file), LexerFileWriter::serialize(mLexer, lines, file));
+        }
+    }
+    mLexer.reset();
+
+    for (const std::string& error : mIo->finish()) {
+        onError(error);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "LexicalAnalyzer.hpp"
+#include "Metrics.hpp"
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Reads, lexes and writes many files, overlapping the file I/O with the lexing
+ * Reads of the next files and writes of the finished outputs are queued while the current file is lexed
+ * Uses io_uring where the kernel allows it, otherwise a reader and a writer thread
+ */
+class LexerFilePipeline {
+public:
+    /**
+     * Where the file reads and writes are queued
+     */
+    class Io {
+    public:
+        struct ReadResult {
+            std::string data;
+            std::string error; // empty on success
+        };
+
+        virtual ~Io() = default;
+
+        // Queues a read, results are collected in the same order with waitRead
+        virtual void startRead(const std::string& path) = 0;
+        virtual ReadResult waitRead() = 0;
+
+        // Queues a write, may block while too many writes are pending
+        virtual void startWrite(const std::filesystem::path& path, std::string data) = 0;
+
+        // Waits for every write, returns messages of failed ones
+        virtual std::vector<std::string> finish() = 0;
+    };
+
+    /**
+     * @param depth Files read ahead and writes in flight
+     * @param useIoUring Set false to always use the threads
+     */
+    explicit LexerFilePipeline(LexicalAnalyzer& lexer, std::size_t depth = 8, bool useIoUring = true);
+    ~LexerFilePipeline();
+
+    /**
+     * Lexes every file and writes its _tokens output, like LexerFileReader followed by LexerFileWriter
+     *
+     * @param onError Called with a message for every file that cannot be read or written
+     */
+    void run(const std::vector<std::string>& files, const std::function<void(const std::string&)>& onError);
+
+    bool isUsingIoUring() const { return mIsUsingIoUring; }
+
+    /**
+     * Records the lex of every file, set nullptr to stop
+     */
+    void setMetrics(LexMetrics* metrics) { mMetrics = metrics; }
+
+private:
+    LexicalAnalyzer& mLexer;
+    std::size_t mDepth;
+    bool mIsUsingIoUring;
+    std::unique_ptr<Io> mIo;
+    LexMetrics* mMetrics = nullptr;
+};
@@ -1,18 +1,55 @@
 #include "LexerFileReader.hpp"
+#include "Trace.hpp"
+#include <algorithm>
 #include <fstream>
 #include <stdexcept>
 
 LexerFileReader::LexerFileReader(LexicalAnalyzer& lexer, const std::string& filePath)
     : mLexer(lexer)
-    , mCurrentLine(0)
 {
-    std::ifstream readFile { filePath };
-    std::string line;
+    std::expected<std::string, LexFailure> source = readSource(filePath, lexer.getOptions().maxBytes);
+    if (!source.has_value()) {
+        bool isOpenError = source.error().kind == LexFailureKind::CANNOT_OPEN;
+        throw std::invalid_argument((isOpenError ? "Cannot open file: " : "Cannot read file: ") + filePath);
+    }
+    mSource = std::move(*source);
+
+    lexer.buildTokens(mSource);
+}
+
+std::expected<std::string, LexFailure> LexerFileReader::readSource(const std::string& filePath, std::uint64_t maxBytes) noexcept
+{
+    std::ifstream readFile;
+    {
+        TraceSpan span { "open", filePath };
+        readFile.open(filePath, std::ios::binary | std::ios::ate);
+    }
     if (!readFile.is_open()) {
-        throw std::invalid_argument("Cannot open file: " + filePath);
+        return std::unexpected(LexFailure { LexFailureKind::CANNOT_OPEN, std::nullopt });
     }
 
-    while (std::getline(readFile, line)) {
-        lexer.buildTokens(line, ++mCurrentLine);
+    std::streamsize size = readFile.tellg();
+    if (size < 0) {
+        return std::unexpected(LexFailure { LexFailureKind::CANNOT_READ, std::nullopt });
+    }
+    // One byte past the limit is enough for the lexer to see that the file is cut
+    if (maxBytes != 0) {
+        size = std::min(size, static_cast<std::streamsize>(maxBytes + 1));
+    }
+    TraceSpan span { "read", filePath };
+    readFile.seekg(0);
+    std::string source;
+    source.resize(static_cast<std::size_t>(size));
+    if (!readFile.read(source.data(), size)) {
+        return std::unexpected(LexFailure { LexFailureKind::CANNOT_READ, std::nullopt });
+    }
+    return source;
+}
+
+const LineIndex& LexerFileReader::getLineIndex() const
+{
+    if (!mLineIndex.has_value()) {
+        mLineIndex.emplace(mSource);
     }
+    return mLineIndex.value();
 }
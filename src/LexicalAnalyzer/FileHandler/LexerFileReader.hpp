@@ -1,6 +1,9 @@
 #pragma once
 
 #include "LexicalAnalyzer.hpp"
+#include "LineIndex.hpp"
+#include <expected>
+#include <optional>
 #include <string>
 
 /**
@@ -9,10 +12,26 @@
  */
 class LexerFileReader {
 public:
+    /**
+     * @throws std::invalid_argument if the file cannot be opened or read
+     */
     LexerFileReader(LexicalAnalyzer& lexer, const std::string& filePath);
 
+    /**
+     * Reads the file without throwing, up to one byte past maxBytes when it is not 0
+     */
+    static std::expected<std::string, LexFailure> readSource(const std::string& filePath, std::uint64_t maxBytes) noexcept;
+
+    const std::string& getSource() const { return mSource; }
+
+    /**
+     * Gets the line table of the source, built on first use
+     */
+    const LineIndex& getLineIndex() const;
+
 private:
     const LexicalAnalyzer& mLexer;
 
-    int mCurrentLine;
+    std::string mSource;
+    mutable std::optional<LineIndex> mLineIndex;
 };
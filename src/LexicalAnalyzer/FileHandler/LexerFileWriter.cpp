@@ -1,20 +1,280 @@
 #include "LexerFileWriter.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <exception>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <thread>
 
-LexerFileWriter::LexerFileWriter(LexicalAnalyzer& lexer, const std::string& filePath)
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+FileSymbols::FileSymbols(std::span<const Token> tokens, const SymbolTable& table)
+    : mTable(table)
+{
+    for (const Token& token : tokens) {
+        if (token.symbol == SymbolTable::npos) {
+            continue;
+        }
+        if (token.symbol >= mLocalIds.size()) {
+            mLocalIds.resize(token.symbol + 1, SymbolTable::npos);
+        }
+        if (mLocalIds[token.symbol] == SymbolTable::npos) {
+            mLocalIds[token.symbol] = static_cast<std::uint32_t>(mSharedIds.size());
+            mSharedIds.push_back(token.symbol);
+        }
+    }
+}
+
+std::vector<std::string> FileSymbols::getNames() const
+{
+    std::vector<std::string> names;
+    names.reserve(mSharedIds.size());
+    for (std::uint32_t symbol : mSharedIds) {
+        names.emplace_back(mTable.getName(symbol));
+    }
+    return names;
+}
+
+LexerFileWriter::LexerFileWriter(LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath)
+    : LexerFileWriter(lexer, lines, filePath, lexer.getTokens())
+{
+}
+
+LexerFileWriter::LexerFileWriter(LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath, std::span<const Token> tokens)
     : mLexer(lexer)
 {
+    {
+        TraceSpan span { "serialize", filePath };
+        mOutput = buildOutput(lexer, lines, filePath, tokens, FileSymbols { tokens, lexer.getSymbolTable() });
+    }
+    TraceSpan span { "write", filePath };
+    std::ofstream writeFile { getOutputPath(filePath) };
+    writeFile << dumpJson(mOutput, 4);
+
+    writeFile.close();
+}
+
+std::string LexerFileWriter::serialize(const LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath)
+{
+    // Same bytes as the constructor writes
+    TraceSpan span { "serialize", filePath };
+    return dumpJson(buildOutput(lexer, lines, filePath, lexer.getTokens(), FileSymbols { lexer.getTokens(), lexer.getSymbolTable() }), 4);
+}
+
+std::vector<std::string> LexerFileWriter::serializeChunks(const LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath, std::span<const Token> tokens, unsigned int threadCount)
+{
+    // Everything but the tokens
+    FileSymbols symbols { tokens, lexer.getSymbolTable() };
+    nlohmann::json frame = buildOutput(lexer, lines, filePath, tokens, symbols, true);
+    if (tokens.empty()) {
+        return { dumpJson(frame, 4) };
+    }
+    // Members are ordered by key, those before and after "tokens" are dumped as objects of their own and joined around the array
+    nlohmann::json before = nlohmann::json::object();
+    nlohmann::json after = nlohmann::json::object();
+    for (auto& member : frame.items()) {
+        if (member.key() != "tokens") {
+            (member.key() < "tokens" ? before : after)[member.key()] = std::move(member.value());
+        }
+    }
+    std::string beforeText = dumpJson(before, 4);
+    std::string afterText = dumpJson(after, 4);
+
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // Small chunks would cost more in thread starts than they save
+    constexpr std::size_t minChunkTokens = 1 << 10;
+    std::size_t chunkCount = std::clamp<std::size_t>(tokens.size() / minChunkTokens, 1, threadCount);
+    std::vector<std::string> pieces(chunkCount + 2);
+    // Dropping the closing "\n}" of before and the opening "{\n" of after leaves their members at the same indent
+    pieces.front() = before.empty() ? "{" : beforeText.substr(0, beforeText.size() - 2) + ",";
+    pieces.front() += "\n    \"tokens\": [";
+    pieces.back() = after.empty() ? "\n    ]\n}" : "\n    ],\n" + afterText.substr(2);
+
+    // Each token is dumped on its own and indented to its depth in the array, dump writes new lines only between members
+    // An exception escaping a worker would terminate, so each chunk keeps its own for the calling thread to rethrow
+    std::vector<std::exception_ptr> failures(chunkCount);
+    auto serializeChunk = [&lines, &symbols](std::span<const Token> chunk, bool isFirst, std::string& out, std::exception_ptr& failure) {
+        TraceSpan span { "serialize chunk" };
+        try {
+            for (const Token& token : chunk) {
+                out += isFirst ? "\n        " : ",\n        ";
+                isFirst = false;
+                std::string object = dumpJson(tokenToJson(token, lines, symbols.getLocalId(token.symbol)), 4);
+                for (char c : object) {
+                    out += c;
+                    if (c == '\n') {
+                        out += "        ";
+                    }
+                }
+            }
+        } catch (...) {
+            failure = std::current_exception();
+        }
+    };
+    std::size_t chunkSize = (tokens.size() + chunkCount - 1) / chunkCount;
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(chunkCount - 1);
+        for (std::size_t i = 1; i < chunkCount; i++) {
+            std::size_t begin = std::min(i * chunkSize, tokens.size());
+            std::span<const Token> chunk = tokens.subspan(begin, std::min(chunkSize, tokens.size() - begin));
+            threads.emplace_back(serializeChunk, chunk, false, std::ref(pieces[i + 1]), std::ref(failures[i]));
+        }
+        serializeChunk(tokens.first(chunkSize), true, pieces[1], failures[0]);
+    }
+    for (const std::exception_ptr& failure : failures) {
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+    return pieces;
+}
+
+bool LexerFileWriter::writeParallel(const LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath, std::span<const Token> tokens, unsigned int threadCount)
+{
+    std::vector<std::string> pieces;
+    {
+        TraceSpan span { "serialize", filePath };
+        pieces = serializeChunks(lexer, lines, filePath, tokens, threadCount);
+    }
+    TraceSpan span { "write", filePath };
+    std::filesystem::path outputPath = getOutputPath(filePath);
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    std::vector<iovec> vectors;
+    vectors.reserve(pieces.size());
+    for (std::string& piece : pieces) {
+        if (!piece.empty()) {
+            vectors.push_back({ piece.data(), piece.size() });
+        }
+    }
+    // Short writes leave the rest of the vectors to write again
+    std::size_t next = 0;
+    while (next < vectors.size()) {
+        int count = static_cast<int>(std::min<std::size_t>(vectors.size() - next, IOV_MAX));
+        ssize_t written = writev(fd, vectors.data() + next, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            return false;
+        }
+        std::size_t remaining = static_cast<std::size_t>(written);
+        while (next < vectors.size() && remaining >= vectors[next].iov_len) {
+            remaining -= vectors[next].iov_len;
+            next++;
+        }
+        if (remaining != 0) {
+            vectors[next].iov_base = static_cast<char*>(vectors[next].iov_base) + remaining;
+            vectors[next].iov_len -= remaining;
+        }
+    }
+    return close(fd) == 0;
+#else
+    std::ofstream writeFile { outputPath, std::ios::binary };
+    for (const std::string& piece : pieces) {
+        writeFile.write(piece.data(), static_cast<std::streamsize>(piece.size()));
+    }
+    writeFile.close();
+    return !writeFile.fail();
+#endif
+}
+
+std::filesystem::path LexerFileWriter::getOutputPath(const std::string& filePath)
+{
+    std::filesystem::path inputPath { filePath };
+    return inputPath.parent_path() / (inputPath.stem().string() + "_tokens" + inputPath.extension().string());
+}
+
+nlohmann::json LexerFileWriter::buildOutput(const LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath, std::span<const Token> tokens, const FileSymbols& symbols, bool isTokensOmitted)
+{
+    nlohmann::json output;
     std::filesystem::path inputPath { filePath };
-    std::filesystem::path outputPath = inputPath.parent_path() / (inputPath.stem().string() + "_tokens" + inputPath.extension().string());
-    std::ofstream writeFile { outputPath };
-    mOutput["file"] = {
+    output["file"] = {
         {"name", inputPath.stem().string()},
         {"type", "specula_src"}
     };
-    mOutput["errors"] = lexer.getErrors();
-    mOutput["tokens"] = lexer.getTokens();
-    writeFile << std::setw(4) << mOutput;
-   
-    writeFile.close();
+
+    nlohmann::json& errors = output["errors"] = nlohmann::json::array();
+    for (const ErrorLines& error : lexer.getErrors()) {
+        errors.push_back(errorToJson(error, lines));
+    }
+    output["symbols"] = symbols.getNames();
+    nlohmann::json& tokensOutput = output["tokens"] = nlohmann::json::array();
+    for (const Token& token : isTokensOmitted ? std::span<const Token> {} : tokens) {
+        tokensOutput.push_back(tokenToJson(token, lines, symbols.getLocalId(token.symbol)));
+    }
+
+    // Literals keep indices into the full token list, only those of the written tokens are kept
+    const std::vector<Token>& allTokens = lexer.getTokens();
+    std::size_t firstToken = tokens.empty() ? 0 : static_cast<std::size_t>(tokens.data() - allTokens.data());
+    nlohmann::json& literals = output["literals"] = nlohmann::json::array();
+    for (const Literal& literal : lexer.getLiterals()) {
+        if (literal.token >= firstToken && literal.token < firstToken + tokens.size()) {
+            literals.push_back(literalToJson(literal, allTokens[literal.token]));
+        }
+    }
+
+    // Trivia after the last written token is kept, it is what comes before the next one
+    if (lexer.getOptions().keepTrivia) {
+        nlohmann::json& trivia = output["trivia"] = nlohmann::json::array();
+        for (const Trivia& entry : lexer.getTrivia()) {
+            if (entry.token >= firstToken && entry.token <= firstToken + tokens.size()) {
+                trivia.push_back(triviaToJson(entry));
+            }
+        }
+    }
+
+    // Token indices are into the full token list like the literals, uses outside the window are dropped
+    if (lexer.getOptions().keepSymbolIndex) {
+        nlohmann::json& symbolIndex = output["symbol_index"] = nlohmann::json::array();
+        SymbolIndex index = lexer.buildSymbolIndex();
+        const std::vector<std::uint32_t>& sharedIds = symbols.getSharedIds();
+        for (std::uint32_t symbol = 0; symbol < sharedIds.size(); symbol++) {
+            nlohmann::json uses = nlohmann::json::array();
+            for (const SymbolOccurrence& occurrence : index.find(sharedIds[symbol])) {
+                if (occurrence.token >= firstToken && occurrence.token < firstToken + tokens.size()) {
+                    uses.push_back(occurrence.token);
+                }
+            }
+            symbolIndex.push_back({ { "symbol", symbol }, { "tokens", std::move(uses) } });
+        }
+    }
+
+    // Pairs are listed once, from their opening, when the opening is written
+    if (lexer.getOptions().keepBracketMatches) {
+        nlohmann::json& brackets = output["bracket_matches"] = nlohmann::json::array();
+        for (std::size_t token = firstToken; token < firstToken + tokens.size(); token++) {
+            std::optional<std::size_t> match = lexer.findMatchingBracket(token);
+            if (match.has_value() && *match > token) {
+                brackets.push_back({ token, *match });
+            }
+        }
+    }
+
+    if (lexer.getTruncation().has_value()) {
+        output["truncated"] = truncationToJson(*lexer.getTruncation());
+    }
+
+    if (tokens.size() != allTokens.size()) {
+        output["viewport"] = {
+            { "first_token", firstToken },
+            { "token_count", allTokens.size() },
+            { "line_count", lines.getLineCount() }
+        };
+    }
+    return output;
 }
@@ -1,38 +1,197 @@
 #pragma once
 
 #include "LexicalAnalyzer.hpp"
+#include "LineIndex.hpp"
 #include "Tokens.hpp"
+#include <array>
+#include <cstdint>
+#include <filesystem>
 #include <nlohmann/json.hpp>
+#include <span>
 #include <string>
+#include <vector>
+
+/**
+ * Symbols used by the tokens of one output, numbered from 0 in order of first use
+ * The symbol table is shared by every file of a run, so outputs list only their own symbols and never depend on the other files
+ */
+class FileSymbols {
+public:
+    FileSymbols(std::span<const Token> tokens, const SymbolTable& table);
+
+    /**
+     * Gets the id written for a symbol of the shared table, npos for tokens without one
+     */
+    std::uint32_t getLocalId(std::uint32_t symbol) const { return symbol < mLocalIds.size() ? mLocalIds[symbol] : SymbolTable::npos; }
+
+    /**
+     * Gets the ids in the shared table, by local id
+     */
+    const std::vector<std::uint32_t>& getSharedIds() const { return mSharedIds; }
+
+    std::vector<std::string> getNames() const;
+
+private:
+    const SymbolTable& mTable;
+    std::vector<std::uint32_t> mLocalIds; // by shared id, npos for symbols the tokens do not use
+    std::vector<std::uint32_t> mSharedIds;
+};
 
 /**
  * Used for writing the output of the lexer to the file
  */
 class LexerFileWriter {
 public:
-    LexerFileWriter(LexicalAnalyzer& lexer, const std::string& filePath);
+    /**
+     * @param lines Line table of the lexed source, used for the line and column of each token
+     */
+    LexerFileWriter(LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath);
+
+    /**
+     * Writes only a window of the tokens, eg. from LexicalAnalyzer::getTokensInLines
+     * The output also gets a "viewport" entry locating the window in the full token list
+     */
+    LexerFileWriter(LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath, std::span<const Token> tokens);
+
+    /**
+     * Gets the bytes the writer would put in the output file, for callers doing their own I/O
+     */
+    static std::string serialize(const LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath);
+
+    /**
+     * Same bytes as serialize, in pieces to be written in order
+     * The tokens are split in one chunk per thread and serialized at the same time
+     *
+     * @param threadCount 0 for one per core
+     */
+    static std::vector<std::string> serializeChunks(const LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath, std::span<const Token> tokens, unsigned int threadCount = 0);
+
+    /**
+     * Writes what the constructor would, serializing with serializeChunks and writing the pieces with one vectored write
+     *
+     * @return false if the output could not be written
+     */
+    static bool writeParallel(const LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath, std::span<const Token> tokens, unsigned int threadCount = 0);
+
+    /**
+     * Gets where the output of the input file is written (eg. dir/file_tokens.ext)
+     */
+    static std::filesystem::path getOutputPath(const std::string& filePath);
 
 private:
     const LexicalAnalyzer& mLexer;
     nlohmann::json mOutput;
+
+    // The "tokens" array is left empty when isTokensOmitted is set, the rest still depends on the window
+    static nlohmann::json buildOutput(const LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath, std::span<const Token> tokens, const FileSymbols& symbols, bool isTokensOmitted = false);
 };
 
-inline void to_json(nlohmann::json& j, const ErrorLines& eL)
+/**
+ * Serializes like dump, writing malformed UTF-8 as U+FFFD instead of throwing
+ * The lexer reports such bytes as errors but keeps them in token values, so every output goes through this
+ *
+ * @param indent -1 for a single line
+ */
+inline std::string dumpJson(const nlohmann::json& j, int indent = -1)
+{
+    return j.dump(indent, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+inline nlohmann::json errorToJson(const ErrorLines& eL, const LineIndex& lines)
 {
-    j = {
+    SourcePosition position = lines.getPosition(eL.offset);
+    return {
         { "message", eL.message },
-        { "line", eL.line },
-        { "charPos", eL.charPos }
+        { "line", position.line },
+        { "charPos", position.column }
+    };
+}
+
+/**
+ * @param symbol Id written for an identifier, eg. from FileSymbols
+ */
+inline nlohmann::json tokenToJson(const Token& token, const LineIndex& lines, std::uint32_t symbol)
+{
+    SourcePosition position = lines.getPosition(token.offset);
+    nlohmann::json j = {
+        { "type", tokenTypeToString(token.type) },
+        { "offset", token.offset },
+        { "length", token.length },
+        { "char_start", position.column },
+        { "char_end", position.column + token.length },
+        { "line", position.line }
+    };
+    // Identifier names are written once in "symbols"
+    if (token.symbol != SymbolTable::npos) {
+        j["symbol"] = symbol;
+    } else {
+        j["value"] = token.value;
+    }
+    return j;
+}
+
+inline nlohmann::json tokenToJson(const Token& token, const LineIndex& lines)
+{
+    return tokenToJson(token, lines, token.symbol);
+}
+
+inline nlohmann::json truncationToJson(const LexerTruncation& truncation)
+{
+    static constexpr std::array<std::string_view, 4> limitNames = { "bytes", "tokens", "errors", "time" };
+    return {
+        { "limit", limitNames[static_cast<std::size_t>(truncation.limit)] },
+        { "offset", truncation.offset }
+    };
+}
+
+inline nlohmann::json triviaToJson(const Trivia& trivia)
+{
+    static constexpr std::array<std::string_view, 3> kindNames = { "whitespace", "new_line", "comment" };
+    return {
+        { "kind", kindNames[static_cast<std::size_t>(trivia.kind)] },
+        { "offset", trivia.offset },
+        { "length", trivia.length },
+        { "token", trivia.token }
     };
 }
 
-inline void to_json(nlohmann::json& j, const Token& token)
+inline nlohmann::json literalToJson(const Literal& literal, const Token& token)
 {
-    j = {
-        { "type", tokenTypeToString.at(token.type) },
-        { "value", token.value },
-        { "char_start", token.charStart },
-        { "char_end", token.charEnd },
-        { "line", token.line }
+    nlohmann::json j = {
+        { "token", literal.token },
+        { "kind", tokenTypeToString(literal.kind) }
     };
+    switch (literal.kind) {
+    case TokenType::L_INT:
+        j["value"] = std::get<std::int64_t>(literal.value);
+        break;
+    case TokenType::L_DOUBLE:
+        j["value"] = std::get<double>(literal.value);
+        break;
+    case TokenType::L_FLOAT:
+        j["value"] = std::get<float>(literal.value);
+        break;
+    case TokenType::L_CHAR:
+        j["value"] = static_cast<std::uint32_t>(std::get<char32_t>(literal.value));
+        break;
+    case TokenType::L_PORT:
+        j["value"] = std::get<std::uint16_t>(literal.value);
+        break;
+    case TokenType::L_URL: {
+        const UrlParts& url = std::get<UrlParts>(literal.value);
+        std::string_view text = token.value;
+        nlohmann::json& value = j["value"] = {
+            { "scheme", text.substr(0, url.schemeLength) },
+            { "host", text.substr(url.hostOffset, url.hostLength) },
+            { "path", text.substr(url.pathOffset) }
+        };
+        if (url.port.has_value()) {
+            value["port"] = *url.port;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return j;
 }
@@ -0,0 +1,70 @@
+#include "LexerHighlightWriter.hpp"
+#include "LexerFileWriter.hpp"
+#include <charconv>
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+void appendNumber(std::string& output, std::uint64_t value)
+{
+    char buffer[20];
+    auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    output.append(buffer, end);
+}
+
+}
+
+LexerHighlightWriter::LexerHighlightWriter(const LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath)
+{
+    std::ofstream writeFile { getOutputPath(filePath), std::ios::binary };
+    writeFile << serialize(lexer, lines, filePath);
+
+    writeFile.close();
+}
+
+std::string LexerHighlightWriter::serialize(const LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath)
+{
+    std::vector<HighlightSpan> spans = buildHighlightSpans(lexer);
+
+    // Only the small parts go through nlohmann, the spans are written by hand
+    nlohmann::json errors = nlohmann::json::array();
+    for (const ErrorLines& error : lexer.getErrors()) {
+        errors.push_back(errorToJson(error, lines));
+    }
+    std::string output;
+    output.reserve(64 + spans.size() * 12);
+    output += "{\"classes\":";
+    output += dumpJson(nlohmann::json(highlightClassNames));
+    output += ",\"errors\":";
+    output += dumpJson(errors);
+    output += ",\"file\":";
+    output += dumpJson(nlohmann::json { { "name", std::filesystem::path { filePath }.stem().string() }, { "type", "specula_highlight" } });
+    output += ",\"spans\":[";
+
+    std::uint64_t previousEnd = 0;
+    for (const HighlightSpan& span : spans) {
+        if (&span != spans.data()) {
+            output += ',';
+        }
+        appendNumber(output, span.offset - previousEnd);
+        output += ',';
+        appendNumber(output, span.length);
+        output += ',';
+        appendNumber(output, static_cast<std::uint64_t>(span.kind));
+        previousEnd = span.offset + span.length;
+    }
+    output += ']';
+    if (lexer.getTruncation().has_value()) {
+        output += ",\"truncated\":";
+        output += dumpJson(truncationToJson(*lexer.getTruncation()));
+    }
+    output += '}';
+    return output;
+}
+
+std::filesystem::path LexerHighlightWriter::getOutputPath(const std::string& filePath)
+{
+    std::filesystem::path inputPath { filePath };
+    return inputPath.parent_path() / (inputPath.stem().string() + "_highlight" + inputPath.extension().string());
+}
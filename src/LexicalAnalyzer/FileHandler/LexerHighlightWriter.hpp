@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Highlight.hpp"
+#include "LexicalAnalyzer.hpp"
+#include "LineIndex.hpp"
+#include <filesystem>
+#include <string>
+
+/**
+ * Used for writing only the highlight spans of the lexer to the file
+ * "spans" is a flat array of (gap, length, class) triples, gap being the bytes since the end of the previous span
+ * and class an index in "classes"
+ */
+class LexerHighlightWriter {
+public:
+    LexerHighlightWriter(const LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath);
+
+    /**
+     * Gets the bytes the writer would put in the output file
+     */
+    static std::string serialize(const LexicalAnalyzer& lexer, const LineIndex& lines, const std::string& filePath);
+
+    /**
+     * Gets where the output of the input file is written (eg. dir/file_highlight.ext)
+     */
+    static std::filesystem::path getOutputPath(const std::string& filePath);
+};
@@ -0,0 +1,38 @@
+#include "LexerOutlineWriter.hpp"
+#include "LexerFileWriter.hpp"
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+LexerOutlineWriter::LexerOutlineWriter(std::span<const OutlineEntry> entries, const LineIndex& lines, const std::string& filePath)
+{
+    std::ofstream writeFile { getOutputPath(filePath), std::ios::binary };
+    writeFile << serialize(entries, lines, filePath);
+
+    writeFile.close();
+}
+
+std::string LexerOutlineWriter::serialize(std::span<const OutlineEntry> entries, const LineIndex& lines, const std::string& filePath)
+{
+    nlohmann::json output;
+    output["file"] = {
+        { "name", std::filesystem::path { filePath }.stem().string() },
+        { "type", "specula_outline" }
+    };
+    nlohmann::json& outline = output["outline"] = nlohmann::json::array();
+    for (const OutlineEntry& entry : entries) {
+        outline.push_back({
+            { "kind", tokenTypeToString(entry.kind) },
+            { "name", entry.name },
+            { "offset", entry.offset },
+            { "length", entry.length },
+            { "line", lines.getPosition(entry.offset).line }
+        });
+    }
+    return dumpJson(output, 4);
+}
+
+std::filesystem::path LexerOutlineWriter::getOutputPath(const std::string& filePath)
+{
+    std::filesystem::path inputPath { filePath };
+    return inputPath.parent_path() / (inputPath.stem().string() + "_outline" + inputPath.extension().string());
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "LineIndex.hpp"
+#include "OutlineScanner.hpp"
+#include <filesystem>
+#include <span>
+#include <string>
+
+/**
+ * Used for writing the declarations found by the OutlineScanner to the file
+ * Each entry has the keyword, name, byte range and the line of the keyword
+ */
+class LexerOutlineWriter {
+public:
+    LexerOutlineWriter(std::span<const OutlineEntry> entries, const LineIndex& lines, const std::string& filePath);
+
+    /**
+     * Gets the bytes the writer would put in the output file
+     */
+    static std::string serialize(std::span<const OutlineEntry> entries, const LineIndex& lines, const std::string& filePath);
+
+    /**
+     * Gets where the output of the input file is written (eg. dir/file_outline.ext)
+     */
+    static std::filesystem::path getOutputPath(const std::string& filePath);
+};
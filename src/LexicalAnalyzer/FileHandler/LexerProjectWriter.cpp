@@ -0,0 +1,63 @@
+#include "LexerProjectWriter.hpp"
+#include "LexerFileWriter.hpp"
+#include "LineIndex.hpp"
+#include <fstream>
+
+LexerProjectWriter::LexerProjectWriter(const ProjectLexer& lexer)
+{
+    const ProjectResult& result = lexer.getResult();
+    for (const ProjectFile& file : result.files) {
+        if (file.failure.has_value()) {
+            continue;
+        }
+        LineIndex lines { file.source };
+        std::ofstream writeFile { LexerFileWriter::getOutputPath(file.path.string()) };
+        writeFile << LexerFileWriter::serialize(file.lexer, lines, file.path.string());
+    }
+    if (result.roots.empty()) {
+        return;
+    }
+
+    std::ofstream writeFile { getGraphPath(result.files[result.roots.front()].path) };
+    writeFile << dumpJson(buildGraph(result, lexer.getSymbolTable()), 4);
+
+    writeFile.close();
+}
+
+nlohmann::json LexerProjectWriter::buildGraph(const ProjectResult& result, const SymbolTable& symbols)
+{
+    nlohmann::json output;
+    output["file"] = {
+        {"name", result.roots.empty() ? "" : result.files[result.roots.front()].path.stem().string()},
+        {"type", "specula_project"}
+    };
+    nlohmann::json& files = output["files"] = nlohmann::json::array();
+    for (const ProjectFile& file : result.files) {
+        nlohmann::json entry = {
+            {"path", file.path.string()},
+            {"imports", file.imports},
+            {"unresolved", file.unresolved}
+        };
+        if (file.failure.has_value()) {
+            entry["failure"] = file.failure == LexFailureKind::CANNOT_OPEN ? "cannot_open" : "cannot_read";
+        }
+        files.push_back(std::move(entry));
+    }
+    output["roots"] = result.roots;
+    if (result.symbolIndex.size() != 0) {
+        nlohmann::json& symbolIndex = output["symbol_index"] = nlohmann::json::array();
+        for (std::uint32_t symbol : result.symbolIndex.getSymbols()) {
+            nlohmann::json uses = nlohmann::json::array();
+            for (const SymbolOccurrence& occurrence : result.symbolIndex.find(symbol)) {
+                uses.push_back({ occurrence.file, occurrence.token });
+            }
+            symbolIndex.push_back({ { "symbol", symbol }, { "name", symbols.getName(symbol) }, { "uses", std::move(uses) } });
+        }
+    }
+    return output;
+}
+
+std::filesystem::path LexerProjectWriter::getGraphPath(const std::filesystem::path& rootPath)
+{
+    return rootPath.parent_path() / (rootPath.stem().string() + "_imports" + rootPath.extension().string());
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "ProjectLexer.hpp"
+#include <filesystem>
+#include <nlohmann/json.hpp>
+#include <string>
+
+/**
+ * Used for writing a lexed project
+ * Every file gets its usual tokens output, the import graph goes next to the first root (eg. dir/main_imports.ext)
+ */
+class LexerProjectWriter {
+public:
+    LexerProjectWriter(const ProjectLexer& lexer);
+
+    /**
+     * Builds the graph output: "files" with each path, the indices it imports and the targets not found
+     * With a symbol index, "symbol_index" lists the (file, token) uses of every symbol of the project
+     */
+    static nlohmann::json buildGraph(const ProjectResult& result, const SymbolTable& symbols);
+
+    static std::filesystem::path getGraphPath(const std::filesystem::path& rootPath);
+};
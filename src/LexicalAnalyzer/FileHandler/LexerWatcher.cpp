@@ -0,0 +1,268 @@
+#include "LexerWatcher.hpp"
+#include "LexerFileReader.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <set>
+#include <string_view>
+#include <thread>
+
+#if defined(__linux__)
+#define SPECULA_USE_INOTIFY 1
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+LexerWatcher::LexerWatcher(const std::filesystem::path& root, const LexerOptions& options)
+    : mRoot(root)
+    , mOptions(options)
+    , mSymbols(std::make_shared<SymbolTable>())
+{
+#if SPECULA_USE_INOTIFY
+    mInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+LexerWatcher::~LexerWatcher()
+{
+#if SPECULA_USE_INOTIFY
+    if (mInotifyFd >= 0) {
+        close(mInotifyFd);
+    }
+#endif
+}
+
+bool LexerWatcher::isOutputFile(const std::filesystem::path& path)
+{
+    std::string stem = path.stem().string();
+    return stem.ends_with("_tokens") || stem.ends_with("_highlight") || stem.ends_with("_imports") || stem.ends_with("_outline");
+}
+
+bool LexerWatcher::isHidden(const std::filesystem::path& path)
+{
+    return path.filename().string().starts_with('.');
+}
+
+bool LexerWatcher::isSource(const std::filesystem::path& path) const
+{
+    std::string extension = path.extension().string();
+    return !isHidden(path) && !isOutputFile(path) && std::ranges::find(mExtensions, extension) != mExtensions.end();
+}
+
+std::vector<std::filesystem::path> LexerWatcher::findSources(const std::filesystem::path& directory) const
+{
+    std::vector<std::filesystem::path> sources;
+    std::error_code error;
+    auto options = std::filesystem::directory_options::skip_permission_denied;
+    for (auto it = std::filesystem::recursive_directory_iterator { directory, options, error }; !error && it != std::filesystem::recursive_directory_iterator {}; it.increment(error)) {
+        if (it->is_directory(error) && isHidden(it->path())) {
+            it.disable_recursion_pending();
+        } else if (it->is_regular_file(error) && isSource(it->path())) {
+            sources.push_back(it->path());
+        }
+    }
+    return sources;
+}
+
+void LexerWatcher::watchTree(const std::filesystem::path& directory)
+{
+#if SPECULA_USE_INOTIFY
+    if (mInotifyFd < 0) {
+        return;
+    }
+    constexpr std::uint32_t events = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE;
+    std::vector<std::filesystem::path> directories { directory };
+    std::error_code error;
+    auto options = std::filesystem::directory_options::skip_permission_denied;
+    for (auto it = std::filesystem::recursive_directory_iterator { directory, options, error }; !error && it != std::filesystem::recursive_directory_iterator {}; it.increment(error)) {
+        if (!it->is_directory(error)) {
+            continue;
+        }
+        if (isHidden(it->path())) {
+            it.disable_recursion_pending();
+        } else {
+            directories.push_back(it->path());
+        }
+    }
+    for (const std::filesystem::path& watched : directories) {
+        int descriptor = inotify_add_watch(mInotifyFd, watched.c_str(), events);
+        if (descriptor >= 0) {
+            mWatchedDirectories[descriptor] = watched;
+        }
+    }
+#else
+    (void)directory;
+#endif
+}
+
+std::optional<LexFailureKind> LexerWatcher::lexFile(const std::filesystem::path& path)
+{
+    std::expected<std::string, LexFailure> source = LexerFileReader::readSource(path.string(), mOptions.maxBytes);
+    if (!source.has_value()) {
+        return source.error().kind;
+    }
+    auto [found, isNew] = mFiles.try_emplace(path);
+    WatchedFile& file = found->second;
+    if (isNew) {
+        file.lexer.setOptions(mOptions);
+        file.lexer.setSymbolTable(mSymbols);
+    }
+    std::error_code error;
+    file.writeTime = std::filesystem::last_write_time(path, error);
+    file.source = std::move(*source);
+
+    // The lexer is reused, so lexing a file again does not allocate once its buffers have grown
+    auto lexStart = std::chrono::steady_clock::now();
+    file.lexer.reset();
+    file.lexer.buildTokens(file.source);
+    if (mMetrics != nullptr) {
+        mMetrics->record(LexSample::of(file.lexer, file.source.size(), std::chrono::steady_clock::now() - lexStart));
+    }
+    return std::nullopt;
+}
+
+void LexerWatcher::refresh(const std::filesystem::path& path, std::vector<WatchChange>& changes)
+{
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error)) {
+        if (mFiles.erase(path) != 0) {
+            changes.push_back({ path, true, std::nullopt });
+        }
+        return;
+    }
+    std::optional<LexFailureKind> failure = lexFile(path);
+    if (failure.has_value()) {
+        // The old tokens would no longer match the file
+        mFiles.erase(path);
+        changes.push_back({ path, true, failure });
+    } else {
+        changes.push_back({ path, false, std::nullopt });
+    }
+}
+
+std::vector<WatchChange> LexerWatcher::lexAll()
+{
+    mFiles.clear();
+    mWatchedDirectories.clear();
+#if SPECULA_USE_INOTIFY
+    // Restart the watches so none is added twice
+    if (mInotifyFd >= 0) {
+        close(mInotifyFd);
+        mInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+#endif
+    // Watched before lexing so no change made meanwhile is missed
+    watchTree(mRoot);
+
+    std::vector<WatchChange> changes;
+    for (const std::filesystem::path& path : findSources(mRoot)) {
+        std::optional<LexFailureKind> failure = lexFile(path);
+        changes.push_back({ path, failure.has_value(), failure });
+    }
+    return changes;
+}
+
+std::vector<WatchChange> LexerWatcher::poll(std::chrono::milliseconds timeout)
+{
+    std::vector<WatchChange> changes;
+#if SPECULA_USE_INOTIFY
+    if (mInotifyFd >= 0) {
+        pollfd descriptor { mInotifyFd, POLLIN, 0 };
+        if (::poll(&descriptor, 1, static_cast<int>(timeout.count())) <= 0) {
+            return changes;
+        }
+
+        // Editors often save with several events, a set handles each file once
+        std::set<std::filesystem::path> changed;
+        std::vector<std::filesystem::path> newDirectories;
+        bool isOverflowed = false;
+        alignas(inotify_event) std::array<char, 1 << 14> buffer;
+        while (true) {
+            ssize_t size = read(mInotifyFd, buffer.data(), buffer.size());
+            if (size <= 0) {
+                break;
+            }
+            for (ssize_t offset = 0; offset < size;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+                if (event->mask & IN_Q_OVERFLOW) {
+                    isOverflowed = true;
+                    continue;
+                }
+                auto directory = mWatchedDirectories.find(event->wd);
+                if (event->mask & IN_IGNORED) {
+                    mWatchedDirectories.erase(event->wd);
+                    continue;
+                }
+                if (directory == mWatchedDirectories.end() || event->len == 0) {
+                    continue;
+                }
+                std::filesystem::path path = directory->second / event->name;
+                if (event->mask & IN_ISDIR) {
+                    if (isHidden(path)) {
+                        continue;
+                    }
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                        newDirectories.push_back(path);
+                    } else {
+                        // Files moved away with their directory send no event of their own
+                        for (auto it = mFiles.lower_bound(path); it != mFiles.end() && std::ranges::mismatch(path, it->first).in1 == path.end(); ++it) {
+                            changed.insert(it->first);
+                        }
+                    }
+                } else if (!(event->mask & IN_CREATE) && isSource(path)) {
+                    changed.insert(path);
+                }
+            }
+        }
+        for (const std::filesystem::path& directory : newDirectories) {
+            watchTree(directory);
+            std::ranges::copy(findSources(directory), std::inserter(changed, changed.end()));
+        }
+        for (const std::filesystem::path& path : changed) {
+            refresh(path, changes);
+        }
+        // Events were dropped, so directories made meanwhile may have no watch and files may have changed unseen
+        if (isOverflowed) {
+            watchTree(mRoot);
+            rescan(changes);
+        }
+        return changes;
+    }
+#endif
+
+    // Without inotify, compare write times after waiting
+    std::this_thread::sleep_for(timeout);
+    rescan(changes);
+    return changes;
+}
+
+void LexerWatcher::rescan(std::vector<WatchChange>& changes)
+{
+    std::vector<std::filesystem::path> sources = findSources(mRoot);
+    std::ranges::sort(sources);
+    std::vector<std::filesystem::path> removed;
+    for (const auto& [path, file] : mFiles) {
+        if (!std::ranges::binary_search(sources, path)) {
+            removed.push_back(path);
+        }
+    }
+    for (const std::filesystem::path& path : removed) {
+        refresh(path, changes);
+    }
+    for (const std::filesystem::path& path : sources) {
+        auto found = mFiles.find(path);
+        std::error_code error;
+        if (found == mFiles.end() || std::filesystem::last_write_time(path, error) != found->second.writeTime) {
+            refresh(path, changes);
+        }
+    }
+}
+
+const WatchedFile* LexerWatcher::findFile(const std::filesystem::path& path) const
+{
+    auto found = mFiles.find(path);
+    return found == mFiles.end() ? nullptr : &found->second;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "LexicalAnalyzer.hpp"
+#include "Metrics.hpp"
+#include "SymbolTable.hpp"
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * A file of the watched tree, kept lexed in memory
+ */
+struct WatchedFile {
+    std::string source;
+    LexicalAnalyzer lexer;
+    std::filesystem::file_time_type writeTime;
+};
+
+struct WatchChange {
+    std::filesystem::path path;
+    bool isRemoved; // the file is gone or cannot be read, otherwise it was lexed again
+    std::optional<LexFailureKind> failure; // set when the file could not be read, it is then left out of the store
+};
+
+/**
+ * Keeps the tokens of every file under a directory and lexes files again as they change
+ * Uses inotify on Linux, elsewhere the tree is scanned for new write times on every poll
+ * When the inotify queue overflows and events are lost, that poll scans the tree the same way
+ * Only files with a source extension are lexed, hidden files and directories like .git are neither walked nor watched
+ * Outputs of the writers (file_tokens, file_highlight, file_imports, file_outline) are not treated as sources
+ */
+class LexerWatcher {
+public:
+    explicit LexerWatcher(const std::filesystem::path& root, const LexerOptions& options = {});
+    ~LexerWatcher();
+
+    LexerWatcher(const LexerWatcher&) = delete;
+    LexerWatcher& operator=(const LexerWatcher&) = delete;
+
+    /**
+     * Lexes every file under the root, replacing what was stored
+     */
+    std::vector<WatchChange> lexAll();
+
+    /**
+     * Waits up to the timeout for files to change, then lexes the changed files again
+     * Events that arrived together are handled once per file
+     */
+    std::vector<WatchChange> poll(std::chrono::milliseconds timeout);
+
+    const WatchedFile* findFile(const std::filesystem::path& path) const;
+    std::size_t size() const { return mFiles.size(); }
+
+    bool isUsingInotify() const { return mInotifyFd >= 0; }
+
+    /**
+     * Records the lex of every file, set nullptr to stop
+     */
+    void setMetrics(LexMetrics* metrics) { mMetrics = metrics; }
+
+    /**
+     * Sets the extensions of the files lexed, like ".spc", used from the next lexAll
+     */
+    void setExtensions(std::vector<std::string> extensions) { mExtensions = std::move(extensions); }
+
+    static bool isOutputFile(const std::filesystem::path& path);
+    // Dot files and directories, kept out of the tree
+    static bool isHidden(const std::filesystem::path& path);
+
+private:
+    std::filesystem::path mRoot;
+    LexerOptions mOptions;
+    std::shared_ptr<SymbolTable> mSymbols; // shared by every file so ids match across the tree
+    std::map<std::filesystem::path, WatchedFile> mFiles;
+    LexMetrics* mMetrics = nullptr;
+    std::vector<std::string> mExtensions { ".spc" };
+
+    int mInotifyFd = -1;
+    std::unordered_map<int, std::filesystem::path> mWatchedDirectories; // by watch descriptor
+
+    // Reads and lexes the file into the store, the failure when it cannot be read
+    std::optional<LexFailureKind> lexFile(const std::filesystem::path& path);
+    // Lexes the file again if it is still there, removes it from the store otherwise
+    void refresh(const std::filesystem::path& path, std::vector<WatchChange>& changes);
+    // Refreshes the files that are gone, new, or have another write time than when they were lexed
+    void rescan(std::vector<WatchChange>& changes);
+    // Adds inotify watches for the directory and everything below it
+    void watchTree(const std::filesystem::path& directory);
+    std::vector<std::filesystem::path> findSources(const std::filesystem::path& directory) const;
+    bool isSource(const std::filesystem::path& path) const;
+};
@@ -0,0 +1,273 @@
+#include "TokenRing.hpp"
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SPECULA_HAS_SHM 1
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// consumerPid of a ring whose consumer detached
+constexpr std::int32_t detachedPid = -1;
+
+std::string getShmName(const std::string& name)
+{
+    return name.starts_with('/') ? name : '/' + name;
+}
+
+#if SPECULA_HAS_SHM
+bool isProcessAlive(std::int32_t pid)
+{
+    // EPERM means the process exists but belongs to another user
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+}
+#endif
+
+void toRecord(const Token& token, TokenRecord& record)
+{
+    std::size_t valueSize = std::min(token.value.size(), sizeof(record.value));
+    record.offset = token.offset;
+    record.length = token.length;
+    record.symbol = token.symbol;
+    record.type = static_cast<std::uint16_t>(token.type);
+    record.valueSize = static_cast<std::uint8_t>(valueSize);
+    record.flags = valueSize < token.value.size() ? TokenRecord::isValueCut : 0;
+    std::memcpy(record.value, token.value.data(), valueSize);
+}
+
+}
+
+TokenRingWriter::TokenRingWriter(const std::string& name, std::size_t capacity, bool isReplacing)
+    : mName(getShmName(name))
+{
+#if SPECULA_HAS_SHM
+    capacity = std::bit_ceil(std::max<std::size_t>(capacity, 2));
+    mMappingSize = recordsOffset + capacity * sizeof(TokenRecord);
+    if (isReplacing) {
+        shm_unlink(mName.c_str());
+    }
+    int fd = shm_open(mName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        throw std::invalid_argument("Shared memory already exists: " + mName);
+    }
+    if (fd < 0) {
+        throw std::invalid_argument("Cannot create shared memory: " + mName);
+    }
+    bool isSized = ftruncate(fd, static_cast<off_t>(mMappingSize)) == 0;
+    mMapping = isSized ? mmap(nullptr, mMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (mMapping == MAP_FAILED) {
+        mMapping = nullptr;
+        shm_unlink(mName.c_str());
+        throw std::invalid_argument("Cannot map shared memory: " + mName);
+    }
+
+    // The memory starts zeroed, the magic is stored last so a consumer never sees a half made header
+    mHeader = new (mMapping) TokenRingHeader {};
+    mHeader->version = TokenRingHeader::expectedVersion;
+    mHeader->capacity = capacity;
+    mRecords = reinterpret_cast<TokenRecord*>(static_cast<char*>(mMapping) + recordsOffset);
+    mHeader->magic.store(TokenRingHeader::expectedMagic, std::memory_order_release);
+#else
+    (void)capacity;
+    (void)isReplacing;
+    throw std::invalid_argument("Shared memory is not supported on this platform: " + mName);
+#endif
+}
+
+TokenRingWriter::~TokenRingWriter()
+{
+#if SPECULA_HAS_SHM
+    if (mMapping != nullptr) {
+        close();
+        munmap(mMapping, mMappingSize);
+        shm_unlink(mName.c_str());
+    }
+#endif
+}
+
+bool TokenRingWriter::waitForTail(std::uint64_t minTail)
+{
+    if (mError.has_value()) {
+        return false;
+    }
+    mCachedTail = mHeader->tail.load(std::memory_order_acquire);
+    // The deadline only covers time without progress, a slow consumer that keeps reading never times out
+    std::uint64_t lastTail = mCachedTail;
+    auto deadline = std::chrono::steady_clock::now() + mTimeout;
+    for (unsigned int spins = 0; mCachedTail < minTail; spins++) {
+        std::this_thread::yield();
+        mCachedTail = mHeader->tail.load(std::memory_order_acquire);
+        if (mCachedTail != lastTail) {
+            lastTail = mCachedTail;
+            deadline = std::chrono::steady_clock::now() + mTimeout;
+            continue;
+        }
+        // Checking the consumer is a system call, so only every few spins
+        if (spins % 64 != 0) {
+            continue;
+        }
+        std::int32_t pid = mHeader->consumerPid.load(std::memory_order_acquire);
+#if SPECULA_HAS_SHM
+        bool isGone = pid == detachedPid || (pid > 0 && !isProcessAlive(pid));
+#else
+        bool isGone = pid == detachedPid;
+#endif
+        if (isGone) {
+            mError = TokenRingError::CONSUMER_GONE;
+            return false;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            mError = TokenRingError::TIMED_OUT;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::uint64_t TokenRingWriter::waitForSpace()
+{
+    std::uint64_t capacity = mHeader->capacity;
+    if (mHead - mCachedTail == capacity && !waitForTail(mHead - capacity + 1)) {
+        return 0;
+    }
+    return capacity - (mHead - mCachedTail);
+}
+
+bool TokenRingWriter::write(std::span<const Token> tokens)
+{
+    std::uint64_t mask = mHeader->capacity - 1;
+    while (!tokens.empty()) {
+        // Published once per batch, so the consumer's cache line is only touched once for many records
+        std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(waitForSpace(), tokens.size()));
+        if (count == 0) {
+            return false;
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            toRecord(tokens[i], mRecords[(mHead + i) & mask]);
+        }
+        mHead += count;
+        mHeader->head.store(mHead, std::memory_order_release);
+        tokens = tokens.subspan(count);
+    }
+    return !mError.has_value();
+}
+
+bool TokenRingWriter::endFile(std::uint64_t sourceSize)
+{
+    if (waitForSpace() == 0) {
+        return false;
+    }
+    TokenRecord& record = mRecords[mHead & (mHeader->capacity - 1)];
+    record = {};
+    record.offset = sourceSize;
+    record.type = TokenRecord::endOfFile;
+    record.symbol = SymbolTable::npos;
+    mHead++;
+    mHeader->head.store(mHead, std::memory_order_release);
+    return true;
+}
+
+void TokenRingWriter::close()
+{
+    mHeader->isClosed.store(1, std::memory_order_release);
+}
+
+bool TokenRingWriter::waitUntilRead()
+{
+    return waitForTail(mHead);
+}
+
+TokenRingReader::TokenRingReader(const std::string& name)
+{
+#if SPECULA_HAS_SHM
+    std::string shmName = getShmName(name);
+    int fd = shm_open(shmName.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        throw std::invalid_argument("Cannot open shared memory: " + shmName);
+    }
+    struct stat status {};
+    bool hasHeader = fstat(fd, &status) == 0 && static_cast<std::size_t>(status.st_size) >= recordsOffset;
+    mMappingSize = hasHeader ? static_cast<std::size_t>(status.st_size) : 0;
+    mMapping = hasHeader ? mmap(nullptr, mMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (mMapping == MAP_FAILED) {
+        mMapping = nullptr;
+        throw std::invalid_argument("Shared memory is not ready: " + shmName);
+    }
+
+    mHeader = static_cast<TokenRingHeader*>(mMapping);
+    bool isReady = mHeader->magic.load(std::memory_order_acquire) == TokenRingHeader::expectedMagic;
+    bool isValid = isReady && mHeader->version == TokenRingHeader::expectedVersion
+        && std::has_single_bit(mHeader->capacity)
+        && recordsOffset + mHeader->capacity * sizeof(TokenRecord) <= mMappingSize;
+    if (!isValid) {
+        munmap(mMapping, mMappingSize);
+        mMapping = nullptr;
+        throw std::invalid_argument("Shared memory is not a token ring: " + shmName);
+    }
+
+    // One consumer at a time, one whose process ended is taken over
+    std::int32_t pid = static_cast<std::int32_t>(getpid());
+    std::int32_t attached = mHeader->consumerPid.load(std::memory_order_acquire);
+    bool isAttached = false;
+    while (!isAttached) {
+        if (attached > 0 && isProcessAlive(attached)) {
+            munmap(mMapping, mMappingSize);
+            mMapping = nullptr;
+            throw std::invalid_argument("Token ring already has a consumer: " + shmName);
+        }
+        isAttached = mHeader->consumerPid.compare_exchange_weak(attached, pid, std::memory_order_acq_rel);
+    }
+    mRecords = reinterpret_cast<const TokenRecord*>(static_cast<const char*>(mMapping) + recordsOffset);
+    mTail = mHeader->tail.load(std::memory_order_relaxed);
+    mCachedHead = mTail;
+#else
+    throw std::invalid_argument("Shared memory is not supported on this platform: " + name);
+#endif
+}
+
+TokenRingReader::~TokenRingReader()
+{
+#if SPECULA_HAS_SHM
+    if (mMapping != nullptr) {
+        mHeader->consumerPid.store(detachedPid, std::memory_order_release);
+        munmap(mMapping, mMappingSize);
+    }
+#endif
+}
+
+std::size_t TokenRingReader::read(std::span<TokenRecord> records)
+{
+    if (mCachedHead == mTail) {
+        mCachedHead = mHeader->head.load(std::memory_order_acquire);
+    }
+    std::uint64_t mask = mHeader->capacity - 1;
+    std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(mCachedHead - mTail, records.size()));
+    for (std::size_t i = 0; i < count; i++) {
+        records[i] = mRecords[(mTail + i) & mask];
+    }
+    // Released after the copies so the producer cannot overwrite a record still being read
+    mTail += count;
+    if (count != 0) {
+        mHeader->tail.store(mTail, std::memory_order_release);
+    }
+    return count;
+}
+
+bool TokenRingReader::isFinished() const
+{
+    // Closed is read first, the head read after it then includes every record
+    return mHeader->isClosed.load(std::memory_order_acquire) != 0 && mHeader->head.load(std::memory_order_acquire) == mTail;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "LexicalAnalyzer.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+/**
+ * One token as it is laid out in the ring, the same on both sides so no decoding is needed
+ * Values longer than the inline bytes are cut, the consumer then reads the token's range of the source
+ */
+struct TokenRecord {
+    static constexpr std::uint16_t endOfFile = UINT16_MAX; // type of the record after the last token of a file
+    static constexpr std::uint8_t isValueCut = 1; // flag, value holds only the first bytes
+
+    std::uint64_t offset; // for endOfFile, the bytes of the file lexed
+    std::uint32_t length;
+    std::uint32_t symbol;
+    std::uint16_t type; // TokenType or endOfFile
+    std::uint8_t valueSize;
+    std::uint8_t flags;
+    char value[44];
+};
+
+static_assert(sizeof(TokenRecord) == 64, "A record fills one cache line");
+
+/**
+ * Start of the shared memory, the records follow at recordsOffset
+ * head and tail count records since the start and only grow, so each side writes only its own
+ */
+struct TokenRingHeader {
+    static constexpr std::uint32_t expectedMagic = 0x53504b52; // "SPKR"
+    static constexpr std::uint32_t expectedVersion = 2;
+
+    std::atomic<std::uint32_t> magic; // set last by the producer, the ring is ready once it matches
+    std::uint32_t version;
+    std::uint64_t capacity; // records, a power of two
+    alignas(64) std::atomic<std::uint64_t> head; // written by the producer
+    alignas(64) std::atomic<std::uint64_t> tail; // written by the consumer
+    alignas(64) std::atomic<std::uint32_t> isClosed; // no record comes after head
+    std::atomic<std::int32_t> consumerPid; // process of the attached consumer, 0 while none is
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "The ring needs lock-free atomics to work across processes");
+static_assert(std::atomic<std::int32_t>::is_always_lock_free, "The ring needs lock-free atomics to work across processes");
+
+inline constexpr std::size_t recordsOffset = (sizeof(TokenRingHeader) + 63) / 64 * 64;
+
+enum class TokenRingError : std::uint8_t {
+    CONSUMER_GONE, // the consumer detached or its process ended
+    TIMED_OUT // no consumer attached, or it read nothing, within the timeout
+};
+
+/**
+ * Producer side of a single producer, single consumer ring of tokens in POSIX shared memory
+ * Pass write as the token callback of the lexer so the consumer gets tokens while the file is still being lexed
+ * Waits for the consumer are bounded, after a failed one every call does nothing and getError tells why
+ */
+class TokenRingWriter {
+public:
+    /**
+     * Creates the shared memory
+     *
+     * @param name Shared memory name, a leading slash is added when missing
+     * @param capacity Records, rounded up to a power of two
+     * @param isReplacing Removes a ring already under the name instead of failing, it may belong to a live producer
+     * @throws std::invalid_argument if the shared memory cannot be created or the name is taken
+     */
+    explicit TokenRingWriter(const std::string& name, std::size_t capacity = 1 << 16, bool isReplacing = false);
+
+    /**
+     * Closes the ring and removes the name, a consumer that opened it keeps reading what is left
+     */
+    ~TokenRingWriter();
+
+    TokenRingWriter(const TokenRingWriter&) = delete;
+    TokenRingWriter& operator=(const TokenRingWriter&) = delete;
+
+    /**
+     * Longest wait for the consumer to attach or to read a record, 5 seconds by default
+     */
+    void setTimeout(std::chrono::milliseconds timeout) { mTimeout = timeout; }
+    std::chrono::milliseconds getTimeout() const { return mTimeout; }
+
+    /**
+     * Copies the tokens into the ring, waiting for the consumer while it is full
+     *
+     * @return false if the consumer is gone or timed out, the tokens not copied then are dropped
+     */
+    bool write(std::span<const Token> tokens);
+
+    /**
+     * Ends the current file with an endOfFile record
+     */
+    bool endFile(std::uint64_t sourceSize);
+
+    /**
+     * Tells the consumer that nothing more comes
+     */
+    void close();
+
+    /**
+     * Waits until the consumer read every record, eg. before removing the ring at exit
+     */
+    bool waitUntilRead();
+
+    const std::optional<TokenRingError>& getError() const { return mError; }
+
+private:
+    std::string mName;
+    void* mMapping = nullptr;
+    std::size_t mMappingSize = 0;
+    TokenRingHeader* mHeader = nullptr;
+    TokenRecord* mRecords = nullptr;
+    std::uint64_t mHead = 0;
+    std::uint64_t mCachedTail = 0; // last tail read, the shared one is only read again when the ring looks full
+    std::chrono::milliseconds mTimeout { 5000 };
+    std::optional<TokenRingError> mError;
+
+    // Waits until the consumer moved the tail past minTail, false and mError set when it cannot
+    bool waitForTail(std::uint64_t minTail);
+    // Waits for free space, returns how many records can be written, 0 after a failed wait
+    std::uint64_t waitForSpace();
+};
+
+/**
+ * Consumer side of the ring, the reference for other consumers of the layout
+ */
+class TokenRingReader {
+public:
+    /**
+     * Attaches as the consumer of the ring
+     *
+     * @throws std::invalid_argument if no ready ring has the name, or a live consumer is attached
+     */
+    explicit TokenRingReader(const std::string& name);
+
+    /**
+     * Detaches, so the producer stops waiting for this consumer
+     */
+    ~TokenRingReader();
+
+    TokenRingReader(const TokenRingReader&) = delete;
+    TokenRingReader& operator=(const TokenRingReader&) = delete;
+
+    /**
+     * Copies up to records.size() records without waiting
+     *
+     * @return Records copied, 0 when none is ready
+     */
+    std::size_t read(std::span<TokenRecord> records);
+
+    /**
+     * Whether the producer closed the ring and every record was read
+     */
+    bool isFinished() const;
+
+private:
+    void* mMapping = nullptr;
+    std::size_t mMappingSize = 0;
+    TokenRingHeader* mHeader = nullptr;
+    const TokenRecord* mRecords = nullptr;
+    std::uint64_t mTail = 0;
+    std::uint64_t mCachedHead = 0;
+};
@@ -0,0 +1,38 @@
+#include "Highlight.hpp"
+
+namespace {
+
+void appendSpan(std::vector<HighlightSpan>& spans, std::uint64_t offset, std::uint32_t length, HighlightClass kind)
+{
+    if (!spans.empty()) {
+        HighlightSpan& last = spans.back();
+        if (last.kind == kind && last.offset + last.length == offset) {
+            last.length += length;
+            return;
+        }
+    }
+    spans.push_back({ offset, length, kind });
+}
+
+}
+
+std::vector<HighlightSpan> buildHighlightSpans(const LexicalAnalyzer& lexer)
+{
+    const std::vector<Token>& tokens = lexer.getTokens();
+    const std::vector<SourceRange>& comments = lexer.getComments();
+    std::vector<HighlightSpan> spans;
+    spans.reserve(tokens.size() + comments.size());
+
+    // Both lists are ordered by offset and never overlap, merge them
+    auto comment = comments.begin();
+    for (const Token& token : tokens) {
+        for (; comment != comments.end() && comment->offset < token.offset; comment++) {
+            appendSpan(spans, comment->offset, comment->length, HighlightClass::COMMENT);
+        }
+        appendSpan(spans, token.offset, token.length, getHighlightClass(token.type));
+    }
+    for (; comment != comments.end(); comment++) {
+        appendSpan(spans, comment->offset, comment->length, HighlightClass::COMMENT);
+    }
+    return spans;
+}
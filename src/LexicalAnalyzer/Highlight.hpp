@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "LexicalAnalyzer.hpp"
+#include "Tokens.hpp"
+
+/**
+ * Coarse token classes, enough for an editor to colorize code
+ */
+enum class HighlightClass : std::uint8_t {
+    KEYWORD,
+    IDENT,
+    LITERAL,
+    OPERATOR, // also delimeters
+    COMMENT,
+    ERROR
+};
+
+inline constexpr std::array<std::string_view, 6> highlightClassNames = { "keyword", "ident", "literal", "operator", "comment", "error" };
+
+struct HighlightSpan {
+    std::uint64_t offset;
+    std::uint32_t length;
+    HighlightClass kind;
+};
+
+/**
+ * Gets the class of a token type, from the prefix of its name in the registry
+ */
+constexpr HighlightClass getHighlightClass(TokenType type)
+{
+    std::string_view name = tokenTypeToString(type);
+    if (type == TokenType::IDENT) {
+        return HighlightClass::IDENT;
+    }
+    if (type == TokenType::UNKNOWN) {
+        return HighlightClass::ERROR;
+    }
+    if (name.starts_with("K_")) {
+        return HighlightClass::KEYWORD;
+    }
+    if (name.starts_with("L_")) {
+        return HighlightClass::LITERAL;
+    }
+    return HighlightClass::OPERATOR;
+}
+
+/**
+ * Gets the spans of the tokens and comments in source order
+ * Spans of the same class that touch are merged into one
+ */
+std::vector<HighlightSpan> buildHighlightSpans(const LexicalAnalyzer& lexer);
@@ -1,26 +1,161 @@
 #include "ErrorLines.hpp"
 #include "LexicalAnalyzer.hpp"
 #include "Tokens.hpp"
-#include <stdexcept>
+#include "Utf8.hpp"
+#include <charconv>
 #include <string>
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::setStateInvalid(std::string message)
+namespace {
+
+// Openings are one character, their text is known from the type
+std::string_view getOpeningText(TokenType type)
+{
+    switch (type) {
+    case TokenType::D_PAR_OP:
+        return "(";
+    case TokenType::D_BRAC_OP:
+        return "[";
+    default:
+        return "{";
+    }
+}
+
+}
+
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::setStateInvalid(std::string_view message, std::string_view detail) -> HandleStateResult
 {
     mCurrentState = LexerState::INVALID;
-    mErrors.push_back(ErrorLines { message, mCharPos, mLine });
+    saveError(message, mOffset, detail);
     return HandleStateResult::REPROCESS;
 }
 
-bool LexicalAnalyzer::isValidIdentifier(char c)
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::recordLiteral(TokenType type)
 {
-    if (mCurrentState == LexerState::START && std::isdigit(static_cast<unsigned char>(c))) {
-        return false;
+    std::uint32_t token = static_cast<std::uint32_t>(mSink.getTokenCount() - 1);
+    const char* first = mLexeme.data();
+    const char* last = mLexeme.data() + mLexeme.size();
+
+    // The states only let digits and one period through, so a failed parse means the value is too large
+    switch (type) {
+    case TokenType::L_INT: {
+        std::int64_t value = 0;
+        auto [end, error] = std::from_chars(first, last, value);
+        if (error == std::errc::result_out_of_range) {
+            saveError("Integer literal out of range", mTokenStart);
+        } else if (error == std::errc {}) {
+            mLiterals.push_back({ token, type, value });
+        }
+        break;
+    }
+    case TokenType::L_DOUBLE: {
+        double value = 0;
+        auto [end, error] = std::from_chars(first, last, value);
+        if (error == std::errc::result_out_of_range) {
+            saveError("Double literal out of range", mTokenStart);
+        } else if (error == std::errc {}) {
+            mLiterals.push_back({ token, type, value });
+        }
+        break;
+    }
+    case TokenType::L_FLOAT: {
+        float value = 0;
+        auto [end, error] = std::from_chars(first, mLexeme.ends_with('f') ? last - 1 : last, value);
+        if (error == std::errc::result_out_of_range) {
+            saveError("Float literal out of range", mTokenStart);
+        } else if (error == std::errc {}) {
+            mLiterals.push_back({ token, type, value });
+        }
+        break;
+    }
+    case TokenType::L_CHAR:
+        if (!mLexeme.empty()) {
+            mLiterals.push_back({ token, type, Utf8::decode(mLexeme) });
+        }
+        break;
+    case TokenType::L_STRING:
+        if (std::optional<UrlParts> url = parseUrl(mLexeme)) {
+            mLiterals.push_back({ token, TokenType::L_URL, *url });
+        } else if (std::optional<std::uint16_t> port = parsePort(mLexeme)) {
+            mLiterals.push_back({ token, TokenType::L_PORT, *port });
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::matchBracket(TokenType type)
+{
+    std::uint32_t token = static_cast<std::uint32_t>(mSink.getTokenCount() - 1);
+    std::optional<TokenType> opening;
+    switch (type) {
+    case TokenType::D_PAR_OP:
+    case TokenType::D_BRAC_OP:
+    case TokenType::D_CBRAC_OP:
+        mOpenBrackets.push_back({ token, type, mTokenStart });
+        return;
+    case TokenType::D_PAR_CLO:
+        opening = TokenType::D_PAR_OP;
+        break;
+    case TokenType::D_BRAC_CLO:
+        opening = TokenType::D_BRAC_OP;
+        break;
+    case TokenType::D_CBRAC_CLO:
+        opening = TokenType::D_CBRAC_OP;
+        break;
+    default:
+        return;
     }
 
-    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    // Openings of another kind above the match were never closed, eg. the `(` of `{ ( }`
+    std::size_t depth = mOpenBrackets.size();
+    while (depth > 0 && mOpenBrackets[depth - 1].type != *opening) {
+        depth--;
+    }
+    if (depth == 0) {
+        saveError("Closing delimiter has no opening one: ", mTokenStart, mLexeme);
+        return;
+    }
+    for (std::size_t i = depth; i < mOpenBrackets.size(); i++) {
+        saveError("Opening delimiter is never closed: ", mOpenBrackets[i].offset, getOpeningText(mOpenBrackets[i].type));
+    }
+    std::uint32_t open = mOpenBrackets[depth - 1].token;
+    mOpenBrackets.resize(depth - 1);
+    mBracketMatches.resize(token + 1, mNoMatch);
+    mBracketMatches[open] = token;
+    mBracketMatches[token] = open;
+}
+
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::closeOpenBrackets()
+{
+    for (const OpenBracket& open : mOpenBrackets) {
+        saveError("Opening delimiter is never closed: ", open.offset, getOpeningText(open.type));
+    }
+    mOpenBrackets.clear();
+}
+
+template <LexerSink Sink, class Features>
+bool BasicLexer<Sink, Features>::isValidIdentifier(char c)
+{
+    unsigned char byte = static_cast<unsigned char>(c);
+    if (byte >= 0x80) {
+        // Any well formed non-ASCII character can be part of an identifier
+        return !mIsInvalidByte;
+    }
+
+    bool isDigit = byte >= '0' && byte <= '9';
+    if (mCurrentState == LexerState::START && isDigit) {
+        return false;
+    }
+    return isDigit || (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || byte == '_';
 }
 
-void LexicalAnalyzer::finalizeIdentifier()
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::finalizeIdentifier()
 {
     std::optional<TokenType> keyword = getKeyword(mLexeme);
     bool isBoolean = mLexeme == "true" || mLexeme == "false";
@@ -34,7 +169,8 @@ void LexicalAnalyzer::finalizeIdentifier()
     }
 }
 
-void LexicalAnalyzer::finalizeIdentifierDash()
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::finalizeIdentifierDash()
 {
     std::optional<TokenType> keyword = getKeyword(mLexeme);
 
@@ -45,20 +181,23 @@ void LexicalAnalyzer::finalizeIdentifierDash()
         if (pos == std::string::npos) {
             setStateInvalid("On identifier dash end state but no dash is found");
         }
-        std::string leftIdent = mLexeme.substr(0, pos);
-        std::string rightIdent = mLexeme.substr(pos + 1);
+        std::string_view leftIdent = std::string_view { mLexeme }.substr(0, pos);
+        std::string_view rightIdent = std::string_view { mLexeme }.substr(pos + 1);
+        // Identifier characters map one to one to the source
+        std::uint64_t dashOffset = mTokenStart + pos;
         if (!leftIdent.empty()) {
-            mTokens.push_back({ TokenType::IDENT, leftIdent });
+            emitToken(TokenType::IDENT, leftIdent, mTokenStart, static_cast<std::uint32_t>(pos));
         }
-        mTokens.push_back({ TokenType::OP_MINUS, "-" });
+        emitToken(TokenType::OP_MINUS, "-", dashOffset, 1);
         if (!rightIdent.empty()) {
-            mTokens.push_back({ TokenType::IDENT, rightIdent });
+            emitToken(TokenType::IDENT, rightIdent, dashOffset + 1, static_cast<std::uint32_t>(rightIdent.size()));
         }
+        mTokenStart = mTokenEnd;
         mLexeme.clear();
     }
 }
 
-bool LexicalAnalyzer::isValidOperator(char c)
+bool LexerRuleset::isValidOperator(char c)
 {
     switch (c) {
     case '=':
@@ -79,7 +218,7 @@ bool LexicalAnalyzer::isValidOperator(char c)
     return false;
 }
 
-LexerState LexicalAnalyzer::getOperatorStartState(char c)
+LexerState LexerRuleset::getOperatorStartState(char c)
 {
     switch (c) {
     case '=':
@@ -97,7 +236,7 @@ LexerState LexicalAnalyzer::getOperatorStartState(char c)
     return LexerState::INVALID; // todo: add error state
 }
 
-TokenType LexicalAnalyzer::getSingleOperatorToken(char c)
+TokenType LexerRuleset::getSingleOperatorToken(char c)
 {
     switch (c) {
     case '=':
@@ -130,7 +269,7 @@ TokenType LexicalAnalyzer::getSingleOperatorToken(char c)
     return TokenType::UNKNOWN;
 }
 
-char LexicalAnalyzer::charToEscapeChar(char c)
+std::optional<char> LexerRuleset::charToEscapeChar(char c)
 {
     switch (c) {
     case '\'':
@@ -154,21 +293,30 @@ char LexicalAnalyzer::charToEscapeChar(char c)
     case 'v':
         return '\v';
     }
-    throw std::invalid_argument("Character is not a valid escape char");
+    return std::nullopt;
 }
 
-std::optional<TokenType> LexicalAnalyzer::getDelimeter(char c)
+std::optional<TokenType> LexerRuleset::getDelimeter(char c)
 {
-    if (mDelimeters.contains(c)) {
-        return mDelimeters.at(c);
+    unsigned char index = static_cast<unsigned char>(c);
+    if (index >= mDelimeters.size()) {
+        return std::nullopt;
     }
-    return std::nullopt;
+    return mDelimeters[index];
 }
 
-std::optional<TokenType> LexicalAnalyzer::getKeyword(std::string_view value)
+std::optional<TokenType> LexerRuleset::getKeyword(std::string_view value)
 {
-    if (mKeywords.contains(value)) {
-        return mKeywords.at(value);
-    }
-    return std::nullopt;
+    return keywordFromString(value);
 }
+
+#define SPECULA_INSTANTIATE_HELPERS(Sink, Features)                                                                           \
+    template auto BasicLexer<Sink, Features>::setStateInvalid(std::string_view, std::string_view) -> HandleStateResult;       \
+    template void BasicLexer<Sink, Features>::recordLiteral(TokenType);                                                       \
+    template void BasicLexer<Sink, Features>::matchBracket(TokenType);                                                        \
+    template void BasicLexer<Sink, Features>::closeOpenBrackets();                                                            \
+    template bool BasicLexer<Sink, Features>::isValidIdentifier(char);                                                        \
+    template void BasicLexer<Sink, Features>::finalizeIdentifier();                                                           \
+    template void BasicLexer<Sink, Features>::finalizeIdentifierDash();
+
+SPECULA_LEXER_INSTANCES(SPECULA_INSTANTIATE_HELPERS)
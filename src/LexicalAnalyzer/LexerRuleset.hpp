@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+#include "Tokens.hpp"
+
+enum class LexerState {
+    START,
+    DELIMETER,
+    EXPECT_DELIMETER, // next character must be a delimeter
+    IDENTIFIER,
+    IDENTIFIER_DASH,
+    NUM_START,
+    DECIMAL_REACHED,
+    FLOAT,
+    CHAR_START,
+    CHAR_END,
+    CHAR_ESCAPE_CHAR,
+    STRING_START,
+    STRING,
+    STRING_ESCAPE_CHAR,
+    OP,
+    OP_EQUALS_NEXT,
+    OP_INCREMENTABLE,
+    OP_LOGICAL,
+    CHAR_SLASH,
+    OP_MINUS,
+    OP_LESS_THAN,
+    OP_GREATER_THAN,
+    OP_LEFT_ARROW,
+    COMMENT,
+    MULTILINE_COMMENT,
+    MULTILINE_COMMENT_END,
+    INVALID
+};
+
+/**
+ * Character classes and tables of the language, shared by every BasicLexer
+ */
+class LexerRuleset {
+protected:
+    static const std::unordered_map<std::string_view, TokenType> mOperators;
+    static const std::array<std::optional<TokenType>, 128> mDelimeters; // indexed by the ascii character
+    static constexpr std::array<char, 2> mForceStringEscape = { '\n', '\r' }; // characters that force string to terminate
+    static constexpr std::array<char, 11> escapeChar = { '\'', '"', '\\', '?', 'a', 'b', 'f', 'n', 'r', 't', 'v' };
+
+    static bool isValidOperator(char c);
+    static LexerState getOperatorStartState(char c);
+    static TokenType getSingleOperatorToken(char c);
+
+    // Appends backslash before it, empty when the character has no escape
+    static std::optional<char> charToEscapeChar(char c);
+
+    static std::optional<TokenType> getDelimeter(char c);
+    static std::optional<TokenType> getKeyword(std::string_view value);
+};
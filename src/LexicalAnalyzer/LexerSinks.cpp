@@ -0,0 +1,157 @@
+#include "LexerSinks.hpp"
+#include <iterator>
+#include <ranges>
+
+namespace {
+
+// Strings up to this size are stored inline and never allocate
+const std::size_t inlineCapacity = std::string().capacity();
+
+}
+
+void TokenStore::saveToken(TokenType type, std::string_view value, std::uint64_t offset, std::uint32_t length, std::uint32_t symbol)
+{
+    mTokens.push_back({ type, takeSpare(mSpareValues, value), offset, length, symbol });
+}
+
+void TokenStore::saveError(std::string_view message, std::string_view detail, std::uint64_t offset)
+{
+    mErrors.push_back({ takeSpare(mSpareMessages, message, detail), offset });
+}
+
+void TokenStore::truncate(std::size_t tokenCount, std::size_t errorCount)
+{
+    if (mTokens.size() > tokenCount) {
+        mTokens.resize(tokenCount);
+    }
+    if (mErrors.size() > errorCount) {
+        mErrors.resize(errorCount);
+    }
+}
+
+void TokenStore::flush()
+{
+    if (mCallback && mFlushedTokens < mTokens.size()) {
+        std::span<const Token> tokens { mTokens };
+        mCallback(tokens.subspan(mFlushedTokens));
+        mFlushedTokens = mTokens.size();
+    }
+}
+
+void TokenStore::reset()
+{
+    recycleStrings();
+    mTokens.clear();
+    mErrors.clear();
+    mFlushedTokens = 0;
+}
+
+void TokenStore::moveTo(std::vector<Token>& tokens, std::vector<ErrorLines>& errors)
+{
+    std::ranges::move(mTokens, std::back_inserter(tokens));
+    std::ranges::move(mErrors, std::back_inserter(errors));
+    mTokens.clear();
+    mErrors.clear();
+    mFlushedTokens = 0;
+}
+
+void TokenStore::recycleStrings()
+{
+    // Pushed last to first so the next lex takes them back in the order they were made
+    for (Token& token : mTokens | std::views::reverse) {
+        if (token.value.capacity() > inlineCapacity) {
+            mSpareValues.push_back(std::move(token.value));
+        }
+    }
+    for (ErrorLines& error : mErrors | std::views::reverse) {
+        if (error.message.capacity() > inlineCapacity) {
+            mSpareMessages.push_back(std::move(error.message));
+        }
+    }
+}
+
+std::string TokenStore::takeSpare(std::vector<std::string>& spares, std::string_view first, std::string_view second)
+{
+    std::size_t size = first.size() + second.size();
+    if (size <= inlineCapacity || spares.empty()) {
+        std::string text;
+        text.reserve(size);
+        text.append(first).append(second);
+        return text;
+    }
+    std::string text = std::move(spares.back());
+    spares.pop_back();
+    text.assign(first).append(second);
+    return text;
+}
+
+void TokenStream::saveToken(TokenType type, std::string_view value, std::uint64_t offset, std::uint32_t length, std::uint32_t symbol)
+{
+    if (mBatchSize == mBatch.size()) {
+        mBatch.emplace_back();
+    }
+    Token& token = mBatch[mBatchSize++];
+    token.type = type;
+    token.value.assign(value);
+    token.offset = offset;
+    token.length = length;
+    token.symbol = symbol;
+    mTokenCount++;
+}
+
+void TokenStream::saveError(std::string_view message, std::string_view detail, std::uint64_t offset)
+{
+    std::string text;
+    text.reserve(message.size() + detail.size());
+    text.append(message).append(detail);
+    mErrors.push_back({ std::move(text), offset });
+}
+
+void TokenStream::truncate(std::size_t tokenCount, std::size_t errorCount)
+{
+    // Limits are checked after every character, so the tokens past one were all saved since the last flush
+    if (mTokenCount > tokenCount) {
+        mBatchSize -= std::min(mBatchSize, mTokenCount - tokenCount);
+        mTokenCount = tokenCount;
+    }
+    if (mErrors.size() > errorCount) {
+        mErrors.resize(errorCount);
+    }
+}
+
+void TokenStream::flush()
+{
+    if (mConsumer && mBatchSize > 0) {
+        mConsumer(std::span<const Token> { mBatch }.first(mBatchSize));
+    }
+    mBatchSize = 0;
+}
+
+void TokenStream::reset()
+{
+    mBatchSize = 0;
+    mTokenCount = 0;
+    mErrors.clear();
+}
+
+void ErrorCollector::saveError(std::string_view message, std::string_view detail, std::uint64_t offset)
+{
+    if (mErrorCount == mErrors.size()) {
+        mErrors.emplace_back();
+    }
+    ErrorLines& error = mErrors[mErrorCount++];
+    error.message.assign(message).append(detail);
+    error.offset = offset;
+}
+
+void ErrorCollector::truncate(std::size_t tokenCount, std::size_t errorCount)
+{
+    mTokenCount = std::min(mTokenCount, tokenCount);
+    mErrorCount = std::min(mErrorCount, errorCount);
+}
+
+void ErrorCollector::reset()
+{
+    mTokenCount = 0;
+    mErrorCount = 0;
+}
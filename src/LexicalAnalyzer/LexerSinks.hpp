@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BasicLexer.hpp"
+#include "ErrorLines.hpp"
+
+/**
+ * Keeps every token and error, the sink of LexicalAnalyzer
+ */
+class TokenStore {
+public:
+    void saveToken(TokenType type, std::string_view value, std::uint64_t offset, std::uint32_t length, std::uint32_t symbol);
+    void saveError(std::string_view message, std::string_view detail, std::uint64_t offset);
+    std::size_t getTokenCount() const { return mTokens.size(); }
+    std::size_t getErrorCount() const { return mErrors.size(); }
+    void truncate(std::size_t tokenCount, std::size_t errorCount);
+    // Passes the tokens saved since the last call to the callback, if there is one
+    void flush();
+
+    /**
+     * The strings of the tokens and errors are kept for the next lex, so lexing similar text again does not allocate
+     */
+    void reset();
+
+    const std::vector<Token>& getTokens() const { return mTokens; }
+    const std::vector<ErrorLines>& getErrors() const { return mErrors; }
+
+    void setCallback(std::function<void(std::span<const Token>)> callback) { mCallback = std::move(callback); }
+
+    /**
+     * Moves the tokens and errors to the end of the given vectors, leaving the store empty
+     */
+    void moveTo(std::vector<Token>& tokens, std::vector<ErrorLines>& errors);
+
+private:
+    std::vector<Token> mTokens;
+    std::vector<ErrorLines> mErrors;
+    std::function<void(std::span<const Token>)> mCallback;
+    std::size_t mFlushedTokens = 0; // tokens already passed to the callback
+    // Strings taken back from tokens and errors on reset, used in order by the next lex
+    std::vector<std::string> mSpareValues;
+    std::vector<std::string> mSpareMessages;
+
+    // Moves the heap allocated strings of the tokens and errors to the spares
+    void recycleStrings();
+    // Copies the text into a spare string when one is left and the text does not fit inline
+    static std::string takeSpare(std::vector<std::string>& spares, std::string_view first, std::string_view second = {});
+};
+
+/**
+ * Passes tokens to a consumer in batches without keeping them, so memory stays flat however long the text
+ * A batch holds what was saved since the last flush, a few KiB of text, and is valid during the call
+ */
+class TokenStream {
+public:
+    void saveToken(TokenType type, std::string_view value, std::uint64_t offset, std::uint32_t length, std::uint32_t symbol);
+    void saveError(std::string_view message, std::string_view detail, std::uint64_t offset);
+    std::size_t getTokenCount() const { return mTokenCount; } // every token since reset, not only the batch
+    std::size_t getErrorCount() const { return mErrors.size(); }
+    void truncate(std::size_t tokenCount, std::size_t errorCount);
+    void flush();
+    void reset();
+
+    const std::vector<ErrorLines>& getErrors() const { return mErrors; }
+
+    /**
+     * Without a consumer the batches are dropped
+     */
+    void setConsumer(std::function<void(std::span<const Token>)> consumer) { mConsumer = std::move(consumer); }
+
+private:
+    std::vector<Token> mBatch; // entries past mBatchSize are kept for their strings
+    std::size_t mBatchSize = 0;
+    std::size_t mTokenCount = 0;
+    std::vector<ErrorLines> mErrors;
+    std::function<void(std::span<const Token>)> mConsumer;
+};
+
+/**
+ * Keeps the errors and only counts the tokens, for checking text
+ */
+class ErrorCollector {
+public:
+    void saveToken(TokenType, std::string_view, std::uint64_t, std::uint32_t, std::uint32_t) { mTokenCount++; }
+    void saveError(std::string_view message, std::string_view detail, std::uint64_t offset);
+    std::size_t getTokenCount() const { return mTokenCount; }
+    std::size_t getErrorCount() const { return mErrorCount; }
+    void truncate(std::size_t tokenCount, std::size_t errorCount);
+    void flush() { }
+    void reset();
+
+    std::span<const ErrorLines> getErrors() const { return std::span { mErrors }.first(mErrorCount); }
+
+private:
+    std::size_t mTokenCount = 0;
+    std::vector<ErrorLines> mErrors; // entries past mErrorCount are kept for their strings
+    std::size_t mErrorCount = 0;
+};
+
+/**
+ * Only counts, for the throughput of the scanner alone
+ */
+class TokenCounter {
+public:
+    void saveToken(TokenType, std::string_view, std::uint64_t, std::uint32_t, std::uint32_t) { mTokenCount++; }
+    void saveError(std::string_view, std::string_view, std::uint64_t) { mErrorCount++; }
+    std::size_t getTokenCount() const { return mTokenCount; }
+    std::size_t getErrorCount() const { return mErrorCount; }
+
+    void truncate(std::size_t tokenCount, std::size_t errorCount)
+    {
+        mTokenCount = std::min(mTokenCount, tokenCount);
+        mErrorCount = std::min(mErrorCount, errorCount);
+    }
+
+    void flush() { }
+
+    void reset()
+    {
+        mTokenCount = 0;
+        mErrorCount = 0;
+    }
+
+private:
+    std::size_t mTokenCount = 0;
+    std::size_t mErrorCount = 0;
+};
+
+/**
+ * Every sink and the features it is compiled with, each file defining members of BasicLexer instantiates them for these
+ */
+#define SPECULA_LEXER_INSTANCES(X)         \
+    X(TokenStore, LexerFeatures)           \
+    X(TokenStream, LexerFeatures)          \
+    X(ErrorCollector, ValidationFeatures)  \
+    X(TokenCounter, ScanFeatures)
+
+using StreamingLexer = BasicLexer<TokenStream>;
+using ValidatingLexer = BasicLexer<ErrorCollector, ValidationFeatures>;
+using CountingLexer = BasicLexer<TokenCounter, ScanFeatures>;
@@ -1,9 +1,12 @@
-#include "LexerError.hpp"
 #include "LexicalAnalyzer.hpp"
 #include "Tokens.hpp"
+#include "Utf8.hpp"
 
-void LexicalAnalyzer::flushLeftoverLexeme()
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::flushLeftoverLexeme()
 {
+    // Whatever is pending consumed everything up to the end of the text
+    mTokenEnd = mOffset;
     switch (mCurrentState) {
     case LexerState::IDENTIFIER:
         if (!mLexeme.empty())
@@ -85,9 +88,16 @@ void LexicalAnalyzer::flushLeftoverLexeme()
     case LexerState::OP_LEFT_ARROW:
         if (!mLexeme.empty())
             saveToken(TokenType::OP_LEFT_OP);
+        break;
     case LexerState::MULTILINE_COMMENT:
     case LexerState::MULTILINE_COMMENT_END:
-        return;
+        // Kept up to the end so highlighting and trivia still cover the text
+        saveError("Multiline comment not closed", mTokenStart);
+        saveComment(mOffset);
+        break;
+    case LexerState::COMMENT:
+        saveComment(mOffset);
+        break;
     case LexerState::INVALID:
         saveToken(TokenType::UNKNOWN);
     default:
@@ -97,7 +107,8 @@ void LexicalAnalyzer::flushLeftoverLexeme()
     resetState();
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleState() -> HandleStateResult
 {
     switch (mCurrentState) {
     case LexerState::START:
@@ -154,19 +165,20 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleState()
         return handleMultilineCommentEndState();
     case LexerState::INVALID:
         return handleInvalidState();
-        // throw LexerError(mInvalidStateMsg, mLine, mCharPos);
     }
 
     return HandleStateResult::CONTINUE;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleStartState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleStartState() -> HandleStateResult
 {
-    mCharStart = mCharPos;
+    mTokenStart = mOffset;
+    mTokenEnd = mOffset;
     if (isValidIdentifier(mToRead)) {
         mCurrentState = LexerState::IDENTIFIER;
         return HandleStateResult::REPROCESS;
-    } else if (std::isdigit(mToRead)) {
+    } else if (std::isdigit(static_cast<unsigned char>(mToRead))) {
         mCurrentState = LexerState::NUM_START;
         return HandleStateResult::REPROCESS;
     } else if (isValidOperator(mToRead)) {
@@ -183,14 +195,18 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleStartState()
         return HandleStateResult::REPROCESS;
     }
 
+    if (mIsInvalidByte) {
+        return setStateInvalid("Invalid UTF-8 character");
+    }
     return setStateInvalid("Unrecognized initial character");
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleInvalidState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleInvalidState() -> HandleStateResult
 {
     bool isDelimeter = getDelimeter(mToRead).has_value();
     if (!isDelimeter) {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         return HandleStateResult::CONTINUE;
     }
     saveToken(TokenType::UNKNOWN);
@@ -198,7 +214,8 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleInvalidState()
     return HandleStateResult::REPROCESS;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleDelimeterState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleDelimeterState() -> HandleStateResult
 {
     std::optional<TokenType> delimeter = getDelimeter(mToRead);
     if (delimeter.has_value()) {
@@ -213,8 +230,10 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleDelimeterState()
             isIgnore = false;
         }
         if (!isIgnore) {
-            mLexeme.push_back(mToRead);
+            appendLexeme(mToRead);
             saveToken(delimeter.value());
+        } else if (Features::hasTrivia && mOptions.keepTrivia) {
+            saveTrivia(delimeter.value() == TokenType::NEW_LINE ? TriviaKind::NEW_LINE : TriviaKind::WHITESPACE, mOffset, 1);
         }
         resetState();
     } else {
@@ -223,7 +242,8 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleDelimeterState()
     return HandleStateResult::CONTINUE;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleExpectDelimeterState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleExpectDelimeterState() -> HandleStateResult
 {
     bool isDelimeter = getDelimeter(mToRead).has_value();
     if (!isDelimeter) {
@@ -233,19 +253,20 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleExpectDelimeterState()
     return HandleStateResult::REPROCESS;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleIdentifierState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleIdentifierState() -> HandleStateResult
 {
     if (isValidIdentifier(mToRead)) {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         return HandleStateResult::CONTINUE;
     }
 
     // Check if its a keyword with a dash
-    const std::string keywordsWithDash[] = { "init", "auto" };
+    constexpr std::string_view keywordsWithDash[] = { "init", "auto" };
     if (mToRead == '-') {
-        for (const std::string& kWithDash : keywordsWithDash) {
+        for (std::string_view kWithDash : keywordsWithDash) {
             if (mLexeme == kWithDash) {
-                mLexeme.push_back(mToRead);
+                appendLexeme(mToRead);
                 mCurrentState = LexerState::IDENTIFIER_DASH;
                 return HandleStateResult::CONTINUE;
             }
@@ -257,10 +278,11 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleIdentifierState()
     return HandleStateResult::REPROCESS;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleIdentifierDashState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleIdentifierDashState() -> HandleStateResult
 {
     if (isValidIdentifier(mToRead)) {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         return HandleStateResult::CONTINUE;
     }
 
@@ -269,15 +291,16 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleIdentifierDashState()
     return HandleStateResult::REPROCESS;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleNumStartState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleNumStartState() -> HandleStateResult
 {
     if (std::isdigit(static_cast<unsigned char>(mToRead))) {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         return HandleStateResult::CONTINUE;
     }
 
     if (mToRead == '.') {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         mCurrentState = LexerState::DECIMAL_REACHED;
         return HandleStateResult::CONTINUE;
     }
@@ -287,16 +310,17 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleNumStartState()
     } else if (getDelimeter(mToRead).has_value()) {
         mCurrentState = LexerState::DELIMETER;
     } else {
-        return setStateInvalid("Integer state does not recognize character: " + std::string { mToRead });
+        return setStateInvalid("Integer state does not recognize character: ", std::string_view { &mToRead, 1 });
     }
     saveToken(TokenType::L_INT);
     return HandleStateResult::REPROCESS;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleDecimalState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleDecimalState() -> HandleStateResult
 {
-    if (std::isdigit(mToRead)) {
-        mLexeme.push_back(mToRead);
+    if (std::isdigit(static_cast<unsigned char>(mToRead))) {
+        appendLexeme(mToRead);
         return HandleStateResult::CONTINUE;
     }
     if (mToRead == 'f') {
@@ -309,10 +333,7 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleDecimalState()
     } else if (getDelimeter(mToRead).has_value()) {
         nextState = LexerState::DELIMETER;
     } else {
-        return setStateInvalid("Decimal state does not recognize character: " + std::string { mToRead });
-    }
-    if (nextState == LexerState::INVALID) {
-        throw LexerError("Decimal state not ended");
+        return setStateInvalid("Decimal state does not recognize character: ", std::string_view { &mToRead, 1 });
     }
 
     if (mLexeme.ends_with('.')) {
@@ -324,18 +345,20 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleDecimalState()
     return HandleStateResult::REPROCESS;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleFloatState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleFloatState() -> HandleStateResult
 {
     if (mToRead != 'f') {
         return setStateInvalid("Float state postfix is not f");
     }
-    mLexeme.push_back(mToRead);
+    appendLexeme(mToRead);
     saveToken(TokenType::L_FLOAT);
     mCurrentState = LexerState::EXPECT_DELIMETER;
     return HandleStateResult::CONTINUE;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleCharStartState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleCharStartState() -> HandleStateResult
 {
     if (mToRead == '\\') {
         mCurrentState = LexerState::CHAR_ESCAPE_CHAR;
@@ -345,6 +368,9 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleCharStartState()
     if (mToRead == '\'') {
         return setStateInvalid("Character is empty");
     }
+    if (mIsInvalidByte) {
+        return setStateInvalid("Invalid UTF-8 character");
+    }
 
     for (char newLine : mForceStringEscape) {
         if (newLine == mToRead) {
@@ -352,42 +378,52 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleCharStartState()
         }
     }
 
-    mLexeme.push_back(mToRead);
+    appendLexeme(mToRead);
     mCurrentState = LexerState::CHAR_END;
 
     return HandleStateResult::CONTINUE;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleCharEndState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleCharEndState() -> HandleStateResult
 {
+    // Rest of a multi-byte character
+    if (Utf8::isContinuation(mToRead) && !mIsInvalidByte && mLexeme.size() < Utf8::getSequenceLength(mLexeme.front())) {
+        appendLexeme(mToRead);
+        return HandleStateResult::CONTINUE;
+    }
     if (mToRead != '\'') {
         return setStateInvalid("Character length is more than 1");
     }
+    mTokenEnd = mOffset + 1;
     saveToken(TokenType::L_CHAR);
     mCurrentState = LexerState::START;
     return HandleStateResult::CONTINUE;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleCharEscapeCharState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleCharEscapeCharState() -> HandleStateResult
 {
     for (char c : escapeChar) {
         if (mToRead == c) {
-            try {
-                mLexeme.push_back(charToEscapeChar(mToRead));
-            } catch (const std::invalid_argument& ex) {
-                return setStateInvalid(ex.what());
+            std::optional<char> escaped = charToEscapeChar(mToRead);
+            if (!escaped.has_value()) {
+                return setStateInvalid("Character is not a valid escape char");
             }
+            appendLexeme(*escaped);
             mCurrentState = LexerState::CHAR_END;
             return HandleStateResult::CONTINUE;
         }
     }
 
-    return setStateInvalid("Character escape state does not recognize character: " + std::string { mToRead });
+    return setStateInvalid("Character escape state does not recognize character: ", std::string_view { &mToRead, 1 });
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleStringState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleStringState() -> HandleStateResult
 {
     if (mToRead == '"') {
+        mTokenEnd = mOffset + 1;
         saveToken(TokenType::L_STRING);
         mCurrentState = LexerState::START;
         return HandleStateResult::CONTINUE;
@@ -396,83 +432,92 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleStringState()
         mCurrentState = LexerState::STRING_ESCAPE_CHAR;
         return HandleStateResult::CONTINUE;
     }
-    // check if it contains newline
+    // Strings cannot span lines, end it here and lex the new line normally
     for (char newLine : mForceStringEscape) {
         if (newLine == mToRead) {
             setStateInvalid("New line before string close");
+            saveToken(TokenType::UNKNOWN);
+            return HandleStateResult::REPROCESS;
         }
     }
-    mLexeme.push_back(mToRead);
+    // Kept in the string so its closing quote still matches
+    if (mIsInvalidByte) {
+        saveError("Invalid UTF-8 character in string", mOffset);
+    }
+    appendLexeme(mToRead);
     mCurrentState = LexerState::STRING;
     return HandleStateResult::CONTINUE;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleStringEscapeCharState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleStringEscapeCharState() -> HandleStateResult
 {
     for (char c : escapeChar) {
         if (mToRead == c) {
-            try {
-                mLexeme.push_back(charToEscapeChar(mToRead));
-            } catch (const std::invalid_argument& ex) {
-                return setStateInvalid(ex.what());
+            std::optional<char> escaped = charToEscapeChar(mToRead);
+            if (!escaped.has_value()) {
+                return setStateInvalid("Character is not a valid escape char");
             }
+            appendLexeme(*escaped);
 
             mCurrentState = LexerState::STRING;
             return HandleStateResult::CONTINUE;
         }
     }
 
-    return setStateInvalid("String escape state does not recognize character: " + std::string { mToRead });
+    return setStateInvalid("String escape state does not recognize character: ", std::string_view { &mToRead, 1 });
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleOpState() -> HandleStateResult
 {
     switch (mToRead) {
     case '/': {
         mCurrentState = LexerState::CHAR_SLASH;
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         return HandleStateResult::CONTINUE;
     }
     case '-': {
         mCurrentState = LexerState::OP_MINUS;
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         return HandleStateResult::CONTINUE;
     }
     case '<': {
         mCurrentState = LexerState::OP_LESS_THAN;
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         return HandleStateResult::CONTINUE;
     }
     case '>': {
         mCurrentState = LexerState::OP_GREATER_THAN;
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         return HandleStateResult::CONTINUE;
     }
     case '&':
     case '|': {
         mCurrentState = LexerState::OP_LOGICAL;
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         return HandleStateResult::CONTINUE;
     }
     case '^':
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         saveToken(TokenType::OP_BITW_XOR);
         return HandleStateResult::CONTINUE;
     case '!':
         mCurrentState = LexerState::OP_EQUALS_NEXT;
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         return HandleStateResult::CONTINUE;
     }
 
     mCurrentState = getOperatorStartState(mToRead);
-    mLexeme.push_back(mToRead);
+    appendLexeme(mToRead);
     return HandleStateResult::CONTINUE;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpEqualsNextState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleOpEqualsNextState() -> HandleStateResult
 {
     if (mToRead == '=') {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         TokenType newToken;
         switch (mLexeme[0]) {
         case '=':
@@ -511,7 +556,8 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpEqualsNextState()
     return HandleStateResult::REPROCESS;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleIncrementableState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleIncrementableState() -> HandleStateResult
 {
     TokenType onEqualsNext;
     bool isPrevAdd = false;
@@ -521,7 +567,7 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleIncrementableState()
     } */
 
     if (mLexeme.size() != 1) {
-        return setStateInvalid("mLexeme is not 1 on entering incrementable " + std::string { mLexeme });
+        return setStateInvalid("mLexeme is not 1 on entering incrementable ", mLexeme);
     }
     isPrevAdd = mLexeme[0] == '+';
 
@@ -531,7 +577,7 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleIncrementableState()
         mCurrentState = LexerState::OP_EQUALS_NEXT;
         return HandleStateResult::REPROCESS;
     } else if (mToRead == incrementChar) {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         TokenType incrementToken = isPrevAdd ? TokenType::OP_INCR : TokenType::OP_DECR;
         saveToken(incrementToken);
         resetState();
@@ -542,7 +588,8 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleIncrementableState()
     return HandleStateResult::REPROCESS;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpLogicalState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleOpLogicalState() -> HandleStateResult
 {
     if (mToRead == '=') {
         mCurrentState = LexerState::OP_EQUALS_NEXT;
@@ -552,10 +599,10 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpLogicalState()
         return setStateInvalid("mLexeme is not 1 on entering op logical state");
     }
 
-    char firstChar = mLexeme.at(0);
+    char firstChar = mLexeme[0];
 
     if (mToRead == firstChar) {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         switch (mToRead) {
         case '&':
             saveToken(TokenType::OP_AND);
@@ -573,7 +620,8 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpLogicalState()
     return HandleStateResult::REPROCESS;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpMinusState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleOpMinusState() -> HandleStateResult
 {
     switch (mToRead) {
     case '-': {
@@ -585,7 +633,7 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpMinusState()
         return HandleStateResult::REPROCESS;
     }
     case '>': {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         saveToken(TokenType::OP_RIGHT_OP);
         resetState();
         return HandleStateResult::CONTINUE;
@@ -596,20 +644,21 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpMinusState()
     return HandleStateResult::REPROCESS;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpLessThanState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleOpLessThanState() -> HandleStateResult
 {
     switch (mToRead) {
     case '=': {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         saveToken(TokenType::OP_REL_LESS_EQ);
         return HandleStateResult::CONTINUE;
     }
     case '-': {
         mCurrentState = LexerState::OP_LEFT_ARROW;
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         return HandleStateResult::CONTINUE;
     case '<': {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         saveToken(TokenType::OP_SHIFT_L);
         return HandleStateResult::CONTINUE;
     }
@@ -619,16 +668,17 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpLessThanState()
     return HandleStateResult::REPROCESS;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpGreaterThanState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleOpGreaterThanState() -> HandleStateResult
 {
     switch (mToRead) {
     case '=': {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         saveToken(TokenType::OP_REL_GREATER_EQ);
         return HandleStateResult::CONTINUE;
     }
     case '>': {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         saveToken(TokenType::OP_SHIFT_R);
         return HandleStateResult::CONTINUE;
     }
@@ -637,10 +687,11 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpGreaterThanState()
     return HandleStateResult::REPROCESS;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpLeftArrowState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleOpLeftArrowState() -> HandleStateResult
 {
     if (mToRead == '>') {
-        mLexeme.push_back(mToRead);
+        appendLexeme(mToRead);
         saveToken(TokenType::OP_BIDIR_OP);
         resetState();
         return HandleStateResult::CONTINUE;
@@ -650,7 +701,8 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleOpLeftArrowState()
     return HandleStateResult::REPROCESS;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleCharSlashState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleCharSlashState() -> HandleStateResult
 {
     if (mToRead == '/') {
         mLexeme.clear();
@@ -666,15 +718,20 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleCharSlashState()
     }
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleCommentState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleCommentState() -> HandleStateResult
 {
-    if (mToRead == '\n') {
+    // The new line is not part of the comment, lex it normally
+    if (mToRead == '\n' || mToRead == '\r') {
+        saveComment(mOffset);
         mCurrentState = LexerState::START;
+        return HandleStateResult::REPROCESS;
     }
     return HandleStateResult::CONTINUE;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleMultilineCommentState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleMultilineCommentState() -> HandleStateResult
 {
     if (mToRead == '*') {
         mCurrentState = LexerState::MULTILINE_COMMENT_END;
@@ -682,9 +739,11 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleMultilineCommentState(
     return HandleStateResult::CONTINUE;
 }
 
-LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleMultilineCommentEndState()
+template <LexerSink Sink, class Features>
+auto BasicLexer<Sink, Features>::handleMultilineCommentEndState() -> HandleStateResult
 {
     if (mToRead == '/') {
+        saveComment(mOffset + 1);
         mCurrentState = LexerState::START;
     } else if (mToRead == '*') {
         return HandleStateResult::CONTINUE;
@@ -693,3 +752,35 @@ LexicalAnalyzer::HandleStateResult LexicalAnalyzer::handleMultilineCommentEndSta
     }
     return HandleStateResult::CONTINUE;
 }
+
+#define SPECULA_INSTANTIATE_STATES(Sink, Features)                                                   \
+    template void BasicLexer<Sink, Features>::flushLeftoverLexeme();                                 \
+    template auto BasicLexer<Sink, Features>::handleState() -> HandleStateResult;                    \
+    template auto BasicLexer<Sink, Features>::handleStartState() -> HandleStateResult;               \
+    template auto BasicLexer<Sink, Features>::handleInvalidState() -> HandleStateResult;             \
+    template auto BasicLexer<Sink, Features>::handleDelimeterState() -> HandleStateResult;           \
+    template auto BasicLexer<Sink, Features>::handleExpectDelimeterState() -> HandleStateResult;     \
+    template auto BasicLexer<Sink, Features>::handleIdentifierState() -> HandleStateResult;          \
+    template auto BasicLexer<Sink, Features>::handleIdentifierDashState() -> HandleStateResult;      \
+    template auto BasicLexer<Sink, Features>::handleNumStartState() -> HandleStateResult;            \
+    template auto BasicLexer<Sink, Features>::handleDecimalState() -> HandleStateResult;             \
+    template auto BasicLexer<Sink, Features>::handleFloatState() -> HandleStateResult;               \
+    template auto BasicLexer<Sink, Features>::handleCharStartState() -> HandleStateResult;           \
+    template auto BasicLexer<Sink, Features>::handleCharEndState() -> HandleStateResult;             \
+    template auto BasicLexer<Sink, Features>::handleCharEscapeCharState() -> HandleStateResult;      \
+    template auto BasicLexer<Sink, Features>::handleStringState() -> HandleStateResult;              \
+    template auto BasicLexer<Sink, Features>::handleStringEscapeCharState() -> HandleStateResult;    \
+    template auto BasicLexer<Sink, Features>::handleOpState() -> HandleStateResult;                  \
+    template auto BasicLexer<Sink, Features>::handleOpEqualsNextState() -> HandleStateResult;        \
+    template auto BasicLexer<Sink, Features>::handleIncrementableState() -> HandleStateResult;       \
+    template auto BasicLexer<Sink, Features>::handleOpLogicalState() -> HandleStateResult;           \
+    template auto BasicLexer<Sink, Features>::handleOpMinusState() -> HandleStateResult;             \
+    template auto BasicLexer<Sink, Features>::handleOpLessThanState() -> HandleStateResult;          \
+    template auto BasicLexer<Sink, Features>::handleOpGreaterThanState() -> HandleStateResult;       \
+    template auto BasicLexer<Sink, Features>::handleOpLeftArrowState() -> HandleStateResult;         \
+    template auto BasicLexer<Sink, Features>::handleCharSlashState() -> HandleStateResult;           \
+    template auto BasicLexer<Sink, Features>::handleCommentState() -> HandleStateResult;             \
+    template auto BasicLexer<Sink, Features>::handleMultilineCommentState() -> HandleStateResult;    \
+    template auto BasicLexer<Sink, Features>::handleMultilineCommentEndState() -> HandleStateResult;
+
+SPECULA_LEXER_INSTANCES(SPECULA_INSTANTIATE_STATES)
@@ -1,56 +1,297 @@
 #include "LexicalAnalyzer.hpp"
 #include "Tokens.hpp"
+#include "Trace.hpp"
+#include "Utf8.hpp"
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 
-LexicalAnalyzer::LexicalAnalyzer(std::string_view text)
+template <LexerSink Sink, class Features>
+BasicLexer<Sink, Features>::BasicLexer()
     : mCurrentState(LexerState::START)
-    , mLine(0)
-    , mCharPos(0)
+    , mOffset(0)
+    , mTokenStart(0)
+    , mTokenEnd(0)
+    , mSymbols(std::make_shared<SymbolTable>())
 {
-    buildTokens(text);
 }
 
-LexicalAnalyzer::LexicalAnalyzer()
-    : mCurrentState(LexerState::START)
-    , mLine(0)
-    , mCharPos(0)
+LexicalAnalyzer::LexicalAnalyzer(std::string_view text)
 {
+    buildTokens(text);
 }
 
-void LexicalAnalyzer::reset()
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::reset()
 {
+    mSink.reset();
     resetState();
-    mTokens.clear();
-    mErrors.clear();
-    mLine = 0;
-    mCharPos = 0;
+    mLiterals.clear();
+    mComments.clear();
+    mTrivia.clear();
+    mSymbolUses.clear();
+    mBracketMatches.clear();
+    mOpenBrackets.clear();
+    mTruncation.reset();
+    mOffset = 0;
+    mTokenStart = 0;
+    mTokenEnd = 0;
 }
 
-void LexicalAnalyzer::resetState()
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::resetState()
 {
     mLexeme.clear();
     mCurrentState = LexerState::START;
 }
 
-void LexicalAnalyzer::saveToken(TokenType type)
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::saveToken(TokenType type)
 {
-    mTokens.push_back({ type, mLexeme, mCharStart, mCharPos, mLine });
+    emitToken(type, mLexeme, mTokenStart, static_cast<std::uint32_t>(mTokenEnd - mTokenStart));
+    if constexpr (Features::hasBrackets) {
+        if (mOptions.keepBracketMatches) {
+            matchBracket(type);
+        }
+    }
+    if constexpr (Features::hasLiterals) {
+        recordLiteral(type);
+    }
+    // The next token starts right after, unless whitespace is skipped in the start state
+    mTokenStart = mTokenEnd;
     mCurrentState = LexerState::START;
     mLexeme.clear();
 }
 
-void LexicalAnalyzer::buildTokens(std::string_view text, int line)
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::emitToken(TokenType type, std::string_view value, std::uint64_t offset, std::uint32_t length)
+{
+    std::uint32_t symbol = SymbolTable::npos;
+    if constexpr (Features::hasSymbols) {
+        if (type == TokenType::IDENT) {
+            symbol = mSymbols->intern(value);
+        }
+    }
+    mSink.saveToken(type, value, offset, length, symbol);
+    if (symbol != SymbolTable::npos && mOptions.keepSymbolIndex) {
+        recordSymbolUse(symbol);
+    }
+}
+
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::saveError(std::string_view message, std::uint64_t offset, std::string_view detail)
+{
+    mSink.saveError(message, detail, offset);
+}
+
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::recordSymbolUse(std::uint32_t symbol)
+{
+    mSymbolUses.push_back({ symbol, { 0, static_cast<std::uint32_t>(mSink.getTokenCount() - 1) } });
+}
+
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::saveComment(std::uint64_t end)
 {
-    mCharPos = 0;
-    mLine = line;
-    for (char c : text) {
-        mToRead = c;
+    if constexpr (Features::hasComments) {
+        std::uint32_t length = static_cast<std::uint32_t>(end - mTokenStart);
+        mComments.push_back({ mTokenStart, length });
+        if (mOptions.keepTrivia) {
+            saveTrivia(TriviaKind::COMMENT, mTokenStart, length);
+        }
+    }
+}
+
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::saveTrivia(TriviaKind kind, std::uint64_t offset, std::uint32_t length)
+{
+    std::uint32_t token = static_cast<std::uint32_t>(mSink.getTokenCount());
+    if (kind != TriviaKind::COMMENT && !mTrivia.empty()) {
+        Trivia& last = mTrivia.back();
+        if (last.kind == kind && last.token == token && last.offset + last.length == offset) {
+            last.length += length;
+            return;
+        }
+    }
+    mTrivia.push_back({ offset, length, token, kind });
+}
+
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::appendLexeme(char c)
+{
+    mLexeme.push_back(c);
+    mTokenEnd = mOffset + 1;
+}
+
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::buildTokens(std::string_view text)
+{
+    if (mTruncation.has_value()) {
+        return;
+    }
+    TraceSpan span { "lex" };
+    bool isOverByteLimit = mOptions.maxBytes != 0 && mOffset + text.size() > mOptions.maxBytes;
+    if (isOverByteLimit) {
+        text = text.substr(0, mOptions.maxBytes - std::min(mOffset, mOptions.maxBytes));
+    }
+
+    // Counts are checked per character, the clock only once per block
+    constexpr std::size_t timeCheckInterval = 1 << 14;
+    std::size_t tokenLimit = mOptions.maxTokens == 0 ? SIZE_MAX : mOptions.maxTokens;
+    std::size_t errorLimit = mOptions.maxErrors == 0 ? SIZE_MAX : mOptions.maxErrors;
+    bool hasTimeLimit = mOptions.timeLimit.count() > 0;
+    auto deadline = std::chrono::steady_clock::now() + mOptions.timeLimit;
+
+    // Validated up front so the states only check a flag, most text has no invalid byte at all
+    std::size_t nextInvalid = Utf8::findInvalid(text);
+    for (std::size_t i = 0; i < text.size(); i++) {
+        mToRead = text[i];
+        mIsInvalidByte = i == nextInvalid;
         HandleStateResult result;
-        mCharPos++;
         do {
             result = handleState();
         } while (result == HandleStateResult::REPROCESS);
+        mOffset++;
+        if (mIsInvalidByte) {
+            nextInvalid = Utf8::findInvalid(text, i + 1);
+        }
+
+        if (mSink.getTokenCount() >= tokenLimit) {
+            truncate(LexerLimit::TOKENS);
+            return;
+        }
+        if (mSink.getErrorCount() >= errorLimit) {
+            truncate(LexerLimit::ERRORS);
+            return;
+        }
+        if (i % timeCheckInterval == 0) {
+            if (hasTimeLimit && std::chrono::steady_clock::now() >= deadline) {
+                truncate(LexerLimit::TIME);
+                return;
+            }
+            // After the limits so a token they drop is never passed on
+            mSink.flush();
+        }
     }
+    mIsInvalidByte = false;
 
+    if (isOverByteLimit) {
+        truncate(LexerLimit::BYTES);
+        return;
+    }
     flushLeftoverLexeme();
+    if (Features::hasBrackets && mOptions.keepBracketMatches) {
+        closeOpenBrackets();
+    }
+    mSink.flush();
 }
+
+std::expected<LexResult, LexFailure> LexicalAnalyzer::lex(std::string_view text) noexcept
+{
+    buildTokens(text);
+    if (getTruncation().has_value()) {
+        return std::unexpected(LexFailure { LexFailureKind::LIMIT, getTruncation() });
+    }
+    return LexResult { getTokens(), getErrors(), getLiterals() };
+}
+
+template <LexerSink Sink, class Features>
+void BasicLexer<Sink, Features>::truncate(LexerLimit limit)
+{
+    mTruncation = LexerTruncation { limit, mOffset };
+    mIsInvalidByte = false;
+    resetState();
+    // Openings are left open by the cut, not by the source
+    mOpenBrackets.clear();
+
+    // One character can finish more than one token or error, keep the counts within the limits
+    if (mOptions.maxTokens != 0 && mSink.getTokenCount() > mOptions.maxTokens) {
+        std::uint32_t tokenCount = static_cast<std::uint32_t>(mOptions.maxTokens);
+        std::erase_if(mLiterals, [tokenCount](const Literal& literal) { return literal.token >= tokenCount; });
+        std::erase_if(mTrivia, [tokenCount](const Trivia& trivia) { return trivia.token > tokenCount; });
+        std::erase_if(mSymbolUses, [tokenCount](const SymbolUse& use) { return use.occurrence.token >= tokenCount; });
+        if (mBracketMatches.size() > tokenCount) {
+            mBracketMatches.resize(tokenCount);
+        }
+        std::ranges::replace_if(mBracketMatches, [tokenCount](std::uint32_t match) { return match != mNoMatch && match >= tokenCount; }, mNoMatch);
+    }
+    mSink.truncate(mOptions.maxTokens == 0 ? SIZE_MAX : mOptions.maxTokens, mOptions.maxErrors == 0 ? SIZE_MAX : mOptions.maxErrors);
+    mSink.flush();
+}
+
+template <LexerSink Sink, class Features>
+const Literal* BasicLexer<Sink, Features>::findLiteral(std::size_t tokenIndex) const
+{
+    auto found = std::ranges::lower_bound(mLiterals, tokenIndex, {}, &Literal::token);
+    if (found == mLiterals.end() || found->token != tokenIndex) {
+        return nullptr;
+    }
+    return &*found;
+}
+
+template <LexerSink Sink, class Features>
+std::optional<std::size_t> BasicLexer<Sink, Features>::findMatchingBracket(std::size_t tokenIndex) const
+{
+    if (tokenIndex >= mBracketMatches.size() || mBracketMatches[tokenIndex] == mNoMatch) {
+        return std::nullopt;
+    }
+    return mBracketMatches[tokenIndex];
+}
+
+template <LexerSink Sink, class Features>
+std::span<const Trivia> BasicLexer<Sink, Features>::getTriviaBefore(std::size_t tokenIndex) const
+{
+    auto [first, last] = std::ranges::equal_range(mTrivia, tokenIndex, {}, &Trivia::token);
+    return { first, last };
+}
+
+void LexicalAnalyzer::appendResultsTo(std::vector<Token>& tokens, std::vector<ErrorLines>& errors, std::vector<Literal>& literals)
+{
+    std::uint32_t tokenBase = static_cast<std::uint32_t>(tokens.size());
+    for (const Literal& literal : getLiterals()) {
+        literals.push_back(literal);
+        literals.back().token += tokenBase;
+    }
+    getSink().moveTo(tokens, errors);
+    reset();
+}
+
+std::span<const Token> LexicalAnalyzer::getTokensInRange(std::uint64_t begin, std::uint64_t end) const
+{
+    const std::vector<Token>& tokens = getTokens();
+    // Tokens never overlap, so both their starts and their ends are sorted
+    auto first = std::ranges::partition_point(tokens, [begin](const Token& token) {
+        return token.offset + token.length <= begin;
+    });
+    auto last = std::ranges::partition_point(first, tokens.end(), [end](const Token& token) {
+        return token.offset < end;
+    });
+    return { first, last };
+}
+
+std::span<const Token> LexicalAnalyzer::getTokensInLines(const LineIndex& lines, std::uint64_t firstLine, std::uint64_t lastLine) const
+{
+    if (firstLine >= lastLine) {
+        return {};
+    }
+    return getTokensInRange(lines.getLineStart(firstLine), lines.getLineStart(lastLine));
+}
+
+#define SPECULA_INSTANTIATE_LEXER(Sink, Features)                                                                                          \
+    template BasicLexer<Sink, Features>::BasicLexer();                                                                                     \
+    template void BasicLexer<Sink, Features>::reset();                                                                                     \
+    template void BasicLexer<Sink, Features>::resetState();                                                                                \
+    template void BasicLexer<Sink, Features>::saveToken(TokenType);                                                                        \
+    template void BasicLexer<Sink, Features>::emitToken(TokenType, std::string_view, std::uint64_t, std::uint32_t);                        \
+    template void BasicLexer<Sink, Features>::saveError(std::string_view, std::uint64_t, std::string_view);                                \
+    template void BasicLexer<Sink, Features>::recordSymbolUse(std::uint32_t);                                                              \
+    template void BasicLexer<Sink, Features>::saveComment(std::uint64_t);                                                                  \
+    template void BasicLexer<Sink, Features>::saveTrivia(TriviaKind, std::uint64_t, std::uint32_t);                                        \
+    template void BasicLexer<Sink, Features>::appendLexeme(char);                                                                          \
+    template void BasicLexer<Sink, Features>::buildTokens(std::string_view);                                                               \
+    template void BasicLexer<Sink, Features>::truncate(LexerLimit);                                                                        \
+    template const Literal* BasicLexer<Sink, Features>::findLiteral(std::size_t) const;                                                    \
+    template std::optional<std::size_t> BasicLexer<Sink, Features>::findMatchingBracket(std::size_t) const;                                \
+    template std::span<const Trivia> BasicLexer<Sink, Features>::getTriviaBefore(std::size_t) const;
+
+SPECULA_LEXER_INSTANCES(SPECULA_INSTANTIATE_LEXER)
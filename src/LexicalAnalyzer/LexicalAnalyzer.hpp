@@ -1,62 +1,52 @@
 #pragma once
 
-#include <array>
+#include <cstdint>
+#include <expected>
+#include <functional>
 #include <optional>
-#include <string>
+#include <span>
 #include <string_view>
-#include <unordered_map>
 #include <vector>
 
+#include "BasicLexer.hpp"
 #include "ErrorLines.hpp"
-#include "Tokens.hpp"
+#include "LexerSinks.hpp"
+#include "LineIndex.hpp"
+#include "Literal.hpp"
 
-struct Token {
-    TokenType type;
-    std::string value;
-    int charStart;
-    int charEnd;
-    int line;
+/**
+ * Views of what a lex produced, valid until the lexer is changed
+ */
+struct LexResult {
+    std::span<const Token> tokens;
+    std::span<const ErrorLines> errors; // malformed tokens, reported without stopping the lex
+    std::span<const Literal> literals;
 };
 
-enum class LexerState {
-    START,
-    DELIMETER,
-    EXPECT_DELIMETER, // next character must be a delimeter
-    IDENTIFIER,
-    IDENTIFIER_DASH,
-    NUM_START,
-    DECIMAL_REACHED,
-    FLOAT,
-    CHAR_START,
-    CHAR_END,
-    CHAR_ESCAPE_CHAR,
-    STRING_START,
-    STRING,
-    STRING_ESCAPE_CHAR,
-    OP,
-    OP_EQUALS_NEXT,
-    OP_INCREMENTABLE,
-    OP_LOGICAL,
-    CHAR_SLASH,
-    OP_MINUS,
-    OP_LESS_THAN,
-    OP_GREATER_THAN,
-    OP_LEFT_ARROW,
-    COMMENT,
-    MULTILINE_COMMENT,
-    MULTILINE_COMMENT_END,
-    INVALID
+enum class LexFailureKind : std::uint8_t {
+    LIMIT, // see truncation, what was lexed before it is still in the lexer
+    CANNOT_OPEN,
+    CANNOT_READ
+};
+
+/**
+ * Why a lex has no complete result
+ */
+struct LexFailure {
+    LexFailureKind kind;
+    std::optional<LexerTruncation> truncation; // set for LIMIT
 };
 
 /**
  * Main class for handling lexical tokens
+ * The lexer with every feature that keeps what it finds, see BasicLexer for the others
  */
-class LexicalAnalyzer {
+class LexicalAnalyzer : public BasicLexer<TokenStore> {
 public:
     /**
      * Default constructor
      */
-    LexicalAnalyzer();
+    LexicalAnalyzer() = default;
 
     /**
      * Constructor but also build tokens
@@ -64,109 +54,47 @@ public:
     LexicalAnalyzer(std::string_view text);
 
     /**
-     * Clears state and tokens
+     * Same as buildTokens but reports a reached limit as a failure
+     * Never throws, the lexer itself has no exceptions and builds with -fno-exceptions
+     * Running out of memory still ends the program
      */
-    void reset();
-
-    /**
-     * Setups tokens based on the text
-     *
-     * @param text Text to parse
-     * @param line Used for error handling
-     *
-     * @throws LexerError
-     */
-    void buildTokens(std::string_view text, int line = -1);
+    std::expected<LexResult, LexFailure> lex(std::string_view text) noexcept;
 
     /**
      * Gets the tokens from the processed string
      */
-    const std::vector<Token>& getTokens() const { return mTokens; }
+    const std::vector<Token>& getTokens() const { return getSink().getTokens(); }
 
     /**
      * Gets all errors in tokenizing
      */
-    const std::vector<ErrorLines>& getErrors() const { return mErrors; }
-
-private:
-    LexerState mCurrentState;
-    char mToRead;
-    std::string mLexeme; // to be appended by build tokens
-
-    int mLine;
-    int mCharPos;
-    int mCharStart;  // saves the start of the token
-
-    std::vector<Token> mTokens;
-    std::vector<ErrorLines> mErrors;
-
-    static const std::unordered_map<std::string_view, TokenType> mOperators;
-    static const std::unordered_map<char, TokenType> mDelimeters;
-    static const std::unordered_map<std::string_view, TokenType> mKeywords;
-    static constexpr std::array<char, 2> mForceStringEscape = { '\n', '\r' }; // characters that force string to terminate
-    static constexpr std::array<char, 11> escapeChar = { '\'', '"', '\\', '?', 'a', 'b', 'f', 'n', 'r', 't', 'v' };
-
-    enum class HandleStateResult {
-        CONTINUE,
-        REPROCESS // When handleState doesn't store the character to the lexeme (mainly for exiting states)
-    };
-
-    // Calls respective state functions
-    HandleStateResult handleState();
+    const std::vector<ErrorLines>& getErrors() const { return getSink().getErrors(); }
 
-    void resetState();
-    // Calls when no string is being read
-    void flushLeftoverLexeme();
-
-    // State functions
-    HandleStateResult handleStartState();
-    HandleStateResult handleInvalidState();
-    HandleStateResult handleDelimeterState();
-    HandleStateResult handleExpectDelimeterState();
-    HandleStateResult handleIdentifierState();
-    HandleStateResult handleIdentifierDashState();
-
-    HandleStateResult handleNumStartState();
-    HandleStateResult handleDecimalState();
-    HandleStateResult handleFloatState();
-    HandleStateResult handleCharStartState();
-    HandleStateResult handleCharEndState();
-    HandleStateResult handleCharEscapeCharState();
-    HandleStateResult handleStringState();
-    HandleStateResult handleStringEscapeCharState();
-
-    HandleStateResult handleOpState();
-    HandleStateResult handleOpEqualsNextState();
-    HandleStateResult handleIncrementableState();
-    HandleStateResult handleOpLogicalState();
-    HandleStateResult handleOpMinusState();
-    HandleStateResult handleOpLessThanState();
-    HandleStateResult handleOpGreaterThanState();
-    HandleStateResult handleOpLeftArrowState();
-
-    HandleStateResult handleCharSlashState();
-    HandleStateResult handleCommentState();
-    HandleStateResult handleMultilineCommentState();
-    HandleStateResult handleMultilineCommentEndState();
-
-    /// Helper functions
-    // Saves contents from mLexeme to mTokens
-    void saveToken(TokenType type);
-
-    // Used for throwing an error
-    HandleStateResult setStateInvalid(std::string message);
-
-    bool isValidIdentifier(char c);
-    void finalizeIdentifier();
-    void finalizeIdentifierDash();
+    /**
+     * Moves the tokens, errors and literals to the end of the given vectors
+     * Token indices of the literals are shifted to match their new position
+     * This lexer keeps its capacity and is left empty, as if reset
+     */
+    void appendResultsTo(std::vector<Token>& tokens, std::vector<ErrorLines>& errors, std::vector<Literal>& literals);
 
-    bool isValidOperator(char c);
-    LexerState getOperatorStartState(char c);
-    TokenType getSingleOperatorToken(char c);
+    /**
+     * Gets the tokens that overlap the byte range [begin, end)
+     * Binary searches the tokens, which are ordered by offset
+     */
+    std::span<const Token> getTokensInRange(std::uint64_t begin, std::uint64_t end) const;
 
-    // Appends backslash before it
-    char charToEscapeChar(char c);
+    /**
+     * Gets the tokens that overlap the lines [firstLine, lastLine)
+     *
+     * @param lines Line table of the text given to buildTokens
+     * @param firstLine Starts at 1
+     */
+    std::span<const Token> getTokensInLines(const LineIndex& lines, std::uint64_t firstLine, std::uint64_t lastLine) const;
 
-    std::optional<TokenType> getDelimeter(char c);
-    std::optional<TokenType> getKeyword(std::string_view value);
+    /**
+     * Called with the tokens saved since the last call, every few KiB of text and when buildTokens returns
+     * Lets a consumer start on the tokens while the rest is still being lexed, set an empty function to stop
+     * Tokens dropped by a limit are never passed
+     */
+    void setTokenCallback(std::function<void(std::span<const Token>)> callback) { getSink().setCallback(std::move(callback)); }
 };
@@ -0,0 +1,60 @@
+#include "LineIndex.hpp"
+#include <algorithm>
+#include <bit>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+LineIndex::LineIndex()
+    : mLineStarts { 0 }
+    , mTextSize(0)
+{
+}
+
+LineIndex::LineIndex(std::string_view text)
+    : mLineStarts { 0 }
+    , mTextSize(text.size())
+{
+    const char* data = text.data();
+    std::uint64_t size = text.size();
+    std::uint64_t i = 0;
+
+#if defined(__SSE2__)
+    // Compare 16 bytes at a time and walk the bits of the matches
+    const __m128i newLine = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newLine)));
+        while (mask != 0) {
+            mLineStarts.push_back(i + std::countr_zero(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < size; i++) {
+        if (data[i] == '\n') {
+            mLineStarts.push_back(i + 1);
+        }
+    }
+}
+
+SourcePosition LineIndex::getPosition(std::uint64_t offset) const
+{
+    offset = std::min(offset, mTextSize);
+    auto next = std::ranges::upper_bound(mLineStarts, offset);
+    std::uint64_t line = static_cast<std::uint64_t>(next - mLineStarts.begin());
+    return { line, offset - mLineStarts[line - 1] + 1 };
+}
+
+std::uint64_t LineIndex::getLineStart(std::uint64_t line) const
+{
+    if (line == 0) {
+        return 0;
+    }
+    if (line > mLineStarts.size()) {
+        return mTextSize;
+    }
+    return mLineStarts[line - 1];
+}
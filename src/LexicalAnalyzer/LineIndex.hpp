@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * Line and column of a byte offset, both starting at 1
+ */
+struct SourcePosition {
+    std::uint64_t line;
+    std::uint64_t column;
+};
+
+/**
+ * Table of the offset where every line starts
+ * Used for turning token offsets back into line and column
+ */
+class LineIndex {
+public:
+    LineIndex();
+
+    /**
+     * Scans the text for new lines
+     */
+    explicit LineIndex(std::string_view text);
+
+    /**
+     * Gets the line and column of the offset
+     * Offsets past the end are placed on the last line
+     */
+    SourcePosition getPosition(std::uint64_t offset) const;
+
+    /**
+     * Gets the offset where the line starts
+     *
+     * @param line Starts at 1. Lines past the end give the offset of the end of the text
+     */
+    std::uint64_t getLineStart(std::uint64_t line) const;
+
+    std::uint64_t getLineCount() const { return mLineStarts.size(); }
+
+private:
+    std::vector<std::uint64_t> mLineStarts;
+    std::uint64_t mTextSize;
+};
@@ -0,0 +1,68 @@
+#include "Literal.hpp"
+#include <algorithm>
+#include <charconv>
+
+namespace {
+
+bool isSchemeChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '+' || c == '-' || c == '.';
+}
+
+std::optional<std::uint16_t> parsePortDigits(std::string_view digits)
+{
+    if (digits.empty() || digits.size() > 5) {
+        return std::nullopt;
+    }
+    unsigned int value = 0;
+    auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+    if (error != std::errc {} || end != digits.data() + digits.size() || value > UINT16_MAX) {
+        return std::nullopt;
+    }
+    return static_cast<std::uint16_t>(value);
+}
+
+}
+
+std::optional<UrlParts> parseUrl(std::string_view text)
+{
+    std::size_t separator = text.find("://");
+    if (separator == std::string_view::npos || separator == 0 || text.find_first_of(" \t") != std::string_view::npos) {
+        return std::nullopt;
+    }
+    std::string_view scheme = text.substr(0, separator);
+    bool isSchemeStartValid = (scheme[0] >= 'a' && scheme[0] <= 'z') || (scheme[0] >= 'A' && scheme[0] <= 'Z');
+    if (!isSchemeStartValid || !std::ranges::all_of(scheme, isSchemeChar)) {
+        return std::nullopt;
+    }
+
+    UrlParts url {};
+    url.schemeLength = static_cast<std::uint32_t>(separator);
+    url.hostOffset = static_cast<std::uint32_t>(separator + 3);
+    std::size_t pathOffset = text.find('/', url.hostOffset);
+    url.pathOffset = static_cast<std::uint32_t>(pathOffset == std::string_view::npos ? text.size() : pathOffset);
+
+    std::string_view authority = text.substr(url.hostOffset, url.pathOffset - url.hostOffset);
+    std::size_t colon = authority.rfind(':');
+    // A colon inside brackets belongs to an IPv6 host
+    if (colon != std::string_view::npos && authority.find(']', colon) == std::string_view::npos) {
+        url.port = parsePortDigits(authority.substr(colon + 1));
+        if (!url.port.has_value()) {
+            return std::nullopt;
+        }
+        authority = authority.substr(0, colon);
+    }
+    if (authority.empty()) {
+        return std::nullopt;
+    }
+    url.hostLength = static_cast<std::uint32_t>(authority.size());
+    return url;
+}
+
+std::optional<std::uint16_t> parsePort(std::string_view text)
+{
+    if (!text.starts_with(':')) {
+        return std::nullopt;
+    }
+    return parsePortDigits(text.substr(1));
+}
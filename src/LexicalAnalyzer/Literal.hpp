@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <variant>
+
+#include "Tokens.hpp"
+
+/**
+ * Parts of a URL string literal (scheme://host[:port][/path]) as byte ranges of the token value
+ */
+struct UrlParts {
+    std::uint32_t schemeLength; // the value starts with the scheme
+    std::uint32_t hostOffset;
+    std::uint32_t hostLength;
+    std::uint32_t pathOffset; // equal to the value size when there is no path
+    std::optional<std::uint16_t> port;
+};
+
+/**
+ * Value of a literal token, computed while lexing so consumers do not parse the text again
+ * L_URL and L_PORT values belong to L_STRING tokens whose content has that shape
+ */
+struct Literal {
+    std::uint32_t token; // index in the token list
+    TokenType kind; // L_INT, L_DOUBLE, L_FLOAT, L_CHAR, L_URL or L_PORT
+    std::variant<std::int64_t, double, float, char32_t, UrlParts, std::uint16_t> value;
+};
+
+/**
+ * Parses "scheme://host[:port][/path]"
+ */
+std::optional<UrlParts> parseUrl(std::string_view text);
+
+/**
+ * Parses a port on its own (":8080")
+ */
+std::optional<std::uint16_t> parsePort(std::string_view text);
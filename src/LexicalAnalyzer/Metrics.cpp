@@ -0,0 +1,248 @@
+#include "Metrics.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Upper bounds of the exported histogram buckets, in nanoseconds
+constexpr std::array<std::uint64_t, 8> exportedBounds = { 1'000, 10'000, 100'000, 1'000'000, 10'000'000, 100'000'000, 1'000'000'000, 10'000'000'000 };
+
+std::atomic<std::uint64_t> nextMetricsId { 0 };
+
+std::uint64_t getPeakRssBytes()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
+
+double toSeconds(std::uint64_t nanoseconds)
+{
+    return static_cast<double>(nanoseconds) / 1e9;
+}
+
+}
+
+void LatencyHistogram::record(std::uint64_t value)
+{
+    mCounts[getBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    mSum.fetch_add(value, std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::getCount() const
+{
+    std::uint64_t count = 0;
+    for (const std::atomic<std::uint64_t>& bucket : mCounts) {
+        count += bucket.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+std::uint64_t LatencyHistogram::getQuantile(double quantile) const
+{
+    std::uint64_t count = getCount();
+    if (count == 0) {
+        return 0;
+    }
+    std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(quantile * static_cast<double>(count))));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < bucketCount; i++) {
+        seen += mCounts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return getBucketLast(i);
+        }
+    }
+    return getBucketLast(bucketCount - 1);
+}
+
+std::uint64_t LatencyHistogram::countAtMost(std::uint64_t limit) const
+{
+    std::uint64_t count = 0;
+    for (std::size_t i = 0; i < bucketCount && getBucketLast(i) <= limit; i++) {
+        count += mCounts[i].load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for (std::size_t i = 0; i < bucketCount; i++) {
+        mCounts[i].fetch_add(other.mCounts[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    mSum.fetch_add(other.getSum(), std::memory_order_relaxed);
+}
+
+std::size_t LatencyHistogram::getBucketIndex(std::uint64_t value)
+{
+    if (value < 2 * subBucketCount) {
+        return static_cast<std::size_t>(value);
+    }
+    std::size_t exponent = static_cast<std::size_t>(std::bit_width(value)) - 1;
+    std::size_t subBucket = static_cast<std::size_t>(value >> (exponent - subBucketBits)) - subBucketCount;
+    return 2 * subBucketCount + (exponent - subBucketBits - 1) * subBucketCount + subBucket;
+}
+
+std::uint64_t LatencyHistogram::getBucketLast(std::size_t index)
+{
+    if (index < 2 * subBucketCount) {
+        return index;
+    }
+    std::size_t exponent = (index - 2 * subBucketCount) / subBucketCount + subBucketBits + 1;
+    std::uint64_t subBucket = (index - 2 * subBucketCount) % subBucketCount;
+    std::uint64_t width = std::uint64_t { 1 } << (exponent - subBucketBits);
+    return (subBucketCount + subBucket) * width + (width - 1);
+}
+
+LexSample LexSample::of(const LexicalAnalyzer& lexer, std::uint64_t bytes, std::chrono::nanoseconds duration)
+{
+    return { bytes, lexer.getTokens().size(), lexer.getErrors().size(), lexer.getTruncation().has_value(), duration };
+}
+
+LexMetrics::LexMetrics()
+    : mId(nextMetricsId.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+LexMetrics::Shard& LexMetrics::getLocalShard()
+{
+    // Ids are never reused, so an entry of a destroyed instance is never matched again
+    thread_local std::vector<std::pair<std::uint64_t, Shard*>> localShards;
+    for (const auto& [id, shard] : localShards) {
+        if (id == mId) {
+            return *shard;
+        }
+    }
+
+    std::lock_guard lock { mShardsMutex };
+    Shard& shard = *mShards.emplace_back(std::make_unique<Shard>());
+    localShards.emplace_back(mId, &shard);
+    return shard;
+}
+
+std::size_t LexMetrics::getSizeBucket(std::uint64_t bytes)
+{
+    auto found = std::ranges::lower_bound(sizeLimits, bytes);
+    return static_cast<std::size_t>(found - sizeLimits.begin());
+}
+
+void LexMetrics::record(const LexSample& sample)
+{
+    Shard& shard = getLocalShard();
+    std::size_t bucket = getSizeBucket(sample.bytes);
+    shard.durations[bucket].record(static_cast<std::uint64_t>(sample.duration.count()));
+
+    Counters& counters = shard.counters[bucket];
+    counters.requests.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(sample.bytes, std::memory_order_relaxed);
+    counters.tokens.fetch_add(sample.tokens, std::memory_order_relaxed);
+    counters.errors.fetch_add(sample.errors, std::memory_order_relaxed);
+    if (sample.errors != 0) {
+        counters.requestsWithErrors.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (sample.isTruncated) {
+        counters.truncated.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void LexMetrics::writePrometheus(std::ostream& out) const
+{
+    // Sum the shards of every thread
+    auto durations = std::make_unique<std::array<LatencyHistogram, sizeLabels.size()>>();
+    std::array<std::array<std::uint64_t, 6>, sizeLabels.size()> totals {};
+    {
+        std::lock_guard lock { mShardsMutex };
+        for (const std::unique_ptr<Shard>& shard : mShards) {
+            for (std::size_t bucket = 0; bucket < sizeLabels.size(); bucket++) {
+                (*durations)[bucket].merge(shard->durations[bucket]);
+                const Counters& counters = shard->counters[bucket];
+                totals[bucket][0] += counters.requests.load(std::memory_order_relaxed);
+                totals[bucket][1] += counters.bytes.load(std::memory_order_relaxed);
+                totals[bucket][2] += counters.tokens.load(std::memory_order_relaxed);
+                totals[bucket][3] += counters.errors.load(std::memory_order_relaxed);
+                totals[bucket][4] += counters.requestsWithErrors.load(std::memory_order_relaxed);
+                totals[bucket][5] += counters.truncated.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    out << std::setprecision(9);
+    out << "# HELP specula_lex_duration_seconds Time to lex one input, by input size\n"
+        << "# TYPE specula_lex_duration_seconds histogram\n";
+    for (std::size_t bucket = 0; bucket < sizeLabels.size(); bucket++) {
+        const LatencyHistogram& histogram = (*durations)[bucket];
+        for (std::uint64_t bound : exportedBounds) {
+            out << "specula_lex_duration_seconds_bucket{size=\"" << sizeLabels[bucket] << "\",le=\"" << toSeconds(bound) << "\"} " << histogram.countAtMost(bound) << '\n';
+        }
+        out << "specula_lex_duration_seconds_bucket{size=\"" << sizeLabels[bucket] << "\",le=\"+Inf\"} " << histogram.getCount() << '\n'
+            << "specula_lex_duration_seconds_sum{size=\"" << sizeLabels[bucket] << "\"} " << toSeconds(histogram.getSum()) << '\n'
+            << "specula_lex_duration_seconds_count{size=\"" << sizeLabels[bucket] << "\"} " << histogram.getCount() << '\n';
+    }
+
+    out << "# HELP specula_lex_duration_quantile_seconds Quantiles of the lex time, within 1/16 of the value\n"
+        << "# TYPE specula_lex_duration_quantile_seconds gauge\n";
+    for (std::size_t bucket = 0; bucket < sizeLabels.size(); bucket++) {
+        for (double quantile : { 0.5, 0.9, 0.99 }) {
+            out << "specula_lex_duration_quantile_seconds{size=\"" << sizeLabels[bucket] << "\",quantile=\"" << quantile << "\"} "
+                << toSeconds((*durations)[bucket].getQuantile(quantile)) << '\n';
+        }
+    }
+
+    struct CounterInfo {
+        std::string_view name;
+        std::string_view help;
+    };
+    constexpr std::array<CounterInfo, 6> counterInfos = { {
+        { "specula_lex_requests_total", "Inputs lexed" },
+        { "specula_lex_bytes_total", "Bytes lexed, divide by the duration sum for bytes per second" },
+        { "specula_lex_tokens_total", "Tokens produced, divide by the duration sum for tokens per second" },
+        { "specula_lex_errors_total", "Lexer errors reported" },
+        { "specula_lex_requests_with_errors_total", "Inputs with at least one lexer error" },
+        { "specula_lex_truncated_total", "Inputs stopped early by a limit" },
+    } };
+    for (std::size_t counter = 0; counter < counterInfos.size(); counter++) {
+        const CounterInfo& info = counterInfos[counter];
+        out << "# HELP " << info.name << ' ' << info.help << "\n# TYPE " << info.name << " counter\n";
+        for (std::size_t bucket = 0; bucket < sizeLabels.size(); bucket++) {
+            out << info.name << "{size=\"" << sizeLabels[bucket] << "\"} " << totals[bucket][counter] << '\n';
+        }
+    }
+
+    out << "# HELP specula_process_peak_rss_bytes Peak resident memory of the process\n"
+        << "# TYPE specula_process_peak_rss_bytes gauge\n"
+        << "specula_process_peak_rss_bytes " << getPeakRssBytes() << '\n';
+}
+
+void LexMetrics::writePrometheus(const std::filesystem::path& path) const
+{
+    if (path == "-") {
+        writePrometheus(std::cout);
+        std::cout.flush();
+        return;
+    }
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream writeFile { temporaryPath };
+        writePrometheus(writeFile);
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+}
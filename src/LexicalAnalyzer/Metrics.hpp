@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include "LexicalAnalyzer.hpp"
+
+/**
+ * Log-linear histogram of non negative values (HDR style)
+ * Values below 32 are exact, above that each power of two is split in 16 buckets, so values are within 1/16
+ * Recording is a relaxed atomic increment, readers may run at the same time
+ */
+class LatencyHistogram {
+public:
+    static constexpr std::size_t subBucketBits = 4;
+    static constexpr std::size_t subBucketCount = 1 << subBucketBits;
+    static constexpr std::size_t bucketCount = 2 * subBucketCount + (63 - subBucketBits) * subBucketCount;
+
+    void record(std::uint64_t value);
+
+    std::uint64_t getCount() const;
+    std::uint64_t getSum() const { return mSum.load(std::memory_order_relaxed); }
+
+    /**
+     * Gets the highest value of the bucket holding the quantile, 0 when empty
+     *
+     * @param quantile Between 0 and 1
+     */
+    std::uint64_t getQuantile(double quantile) const;
+
+    /**
+     * Counts the values whose bucket ends at or below the limit
+     */
+    std::uint64_t countAtMost(std::uint64_t limit) const;
+
+    /**
+     * Adds the counts of another histogram to this one
+     */
+    void merge(const LatencyHistogram& other);
+
+    static std::size_t getBucketIndex(std::uint64_t value);
+    static std::uint64_t getBucketLast(std::size_t index);
+
+private:
+    std::array<std::atomic<std::uint64_t>, bucketCount> mCounts {};
+    std::atomic<std::uint64_t> mSum { 0 };
+};
+
+/**
+ * What one lex measured
+ */
+struct LexSample {
+    std::uint64_t bytes;
+    std::size_t tokens;
+    std::size_t errors;
+    bool isTruncated;
+    std::chrono::nanoseconds duration;
+
+    static LexSample of(const LexicalAnalyzer& lexer, std::uint64_t bytes, std::chrono::nanoseconds duration);
+};
+
+/**
+ * Lex latency and throughput, broken down by input size, exported in the Prometheus text format
+ * Every thread records into its own shard without locking, shards are summed when exporting
+ */
+class LexMetrics {
+public:
+    // Upper size of each input size bucket, the last one has no limit
+    static constexpr std::array<std::uint64_t, 4> sizeLimits = { 1 << 10, 16 << 10, 256 << 10, 4 << 20 };
+    static constexpr std::array<std::string_view, 5> sizeLabels = { "1KiB", "16KiB", "256KiB", "4MiB", "inf" };
+
+    LexMetrics();
+
+    void record(const LexSample& sample);
+
+    void writePrometheus(std::ostream& out) const;
+
+    /**
+     * Writes to a temporary file next to the path and renames it, so scrapers never read half a file
+     * A path of "-" writes to stdout
+     */
+    void writePrometheus(const std::filesystem::path& path) const;
+
+private:
+    struct Counters {
+        std::atomic<std::uint64_t> requests { 0 };
+        std::atomic<std::uint64_t> bytes { 0 };
+        std::atomic<std::uint64_t> tokens { 0 };
+        std::atomic<std::uint64_t> errors { 0 };
+        std::atomic<std::uint64_t> requestsWithErrors { 0 };
+        std::atomic<std::uint64_t> truncated { 0 };
+    };
+
+    struct Shard {
+        std::array<LatencyHistogram, sizeLabels.size()> durations;
+        std::array<Counters, sizeLabels.size()> counters;
+    };
+
+    std::uint64_t mId; // tells the shards of each instance apart in the thread local cache
+    mutable std::mutex mShardsMutex; // only taken by a thread recording for the first time and by exports
+    std::vector<std::unique_ptr<Shard>> mShards;
+
+    Shard& getLocalShard();
+    static std::size_t getSizeBucket(std::uint64_t bytes);
+};
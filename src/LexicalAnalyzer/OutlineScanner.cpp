@@ -0,0 +1,185 @@
+#include "OutlineScanner.hpp"
+#include <algorithm>
+
+namespace {
+
+bool isWordChar(char c)
+{
+    unsigned char byte = static_cast<unsigned char>(c);
+    return byte >= 0x80 || (byte >= '0' && byte <= '9') || (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || byte == '_';
+}
+
+// Gets the end of the word at the offset, dashes between word characters included like init-state
+std::size_t skipWord(std::string_view text, std::size_t offset)
+{
+    while (offset < text.size()) {
+        if (isWordChar(text[offset])) {
+            offset++;
+        } else if (text[offset] == '-' && offset + 1 < text.size() && isWordChar(text[offset + 1])) {
+            offset += 2;
+        } else {
+            break;
+        }
+    }
+    return offset;
+}
+
+// Gets the end of the string or char opened at the offset, which also ends at a new line like in the lexer
+std::size_t skipQuoted(std::string_view text, std::size_t offset)
+{
+    char quote = text[offset];
+    for (offset++; offset < text.size(); offset++) {
+        char c = text[offset];
+        if (c == '\\') {
+            offset++;
+        } else if (c == quote) {
+            return offset + 1;
+        } else if (c == '\n' || c == '\r') {
+            return offset;
+        }
+    }
+    return text.size();
+}
+
+// Gets the end of the comment at the offset, the offset itself when the slash starts none
+std::size_t skipComment(std::string_view text, std::size_t offset)
+{
+    if (offset + 1 >= text.size()) {
+        return offset;
+    }
+    if (text[offset + 1] == '/') {
+        std::size_t end = text.find('\n', offset + 2);
+        return end == std::string_view::npos ? text.size() : end;
+    }
+    if (text[offset + 1] == '*') {
+        std::size_t end = text.find("*/", offset + 2);
+        return end == std::string_view::npos ? text.size() : end + 2;
+    }
+    return offset;
+}
+
+// Gets the offset after the brace closing the one at the offset, the end of the text when it is never closed
+std::size_t skipBody(std::string_view text, std::size_t offset)
+{
+    std::size_t depth = 0;
+    while (true) {
+        // Jumping between the only characters that matter keeps this at memchr speed on plain code
+        offset = text.find_first_of("{}\"'/", offset);
+        if (offset == std::string_view::npos) {
+            return text.size();
+        }
+        switch (text[offset]) {
+        case '{':
+            depth++;
+            offset++;
+            break;
+        case '}':
+            offset++;
+            if (--depth == 0) {
+                return offset;
+            }
+            break;
+        case '/':
+            offset = std::max(skipComment(text, offset), offset + 1);
+            break;
+        default:
+            offset = skipQuoted(text, offset);
+            break;
+        }
+    }
+}
+
+}
+
+bool OutlineScanner::isOutlineKind(TokenType type)
+{
+    switch (type) {
+    case TokenType::K_CONTRACT:
+    case TokenType::K_LISTENER:
+    case TokenType::K_STATE:
+    case TokenType::K_FN:
+    case TokenType::K_STRUCT:
+    case TokenType::K_INTERFACE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+const std::vector<OutlineEntry>& OutlineScanner::scan(std::string_view source)
+{
+    mEntries.clear();
+    scanLevel(source, 0, source.size(), true);
+    return mEntries;
+}
+
+void OutlineScanner::scanLevel(std::string_view source, std::size_t offset, std::size_t end, bool isTopLevel)
+{
+    while (offset < end) {
+        char c = source[offset];
+        if (c == '"' || c == '\'') {
+            offset = skipQuoted(source, offset);
+        } else if (c == '/') {
+            offset = std::max(skipComment(source, offset), offset + 1);
+        } else if (c == '{') {
+            // Braces outside a declaration, eg. a struct literal assigned at the top level
+            offset = skipBody(source, offset);
+        } else if (isWordChar(c)) {
+            std::size_t wordEnd = skipWord(source, offset);
+            bool isMember = offset > 0 && source[offset - 1] == '.';
+            std::optional<TokenType> keyword = keywordFromString(source.substr(offset, wordEnd - offset));
+            if (!isMember && keyword.has_value() && isOutlineKind(*keyword)) {
+                wordEnd = scanDeclaration(source, offset, *keyword, isTopLevel);
+            }
+            offset = wordEnd;
+        } else {
+            offset++;
+        }
+    }
+}
+
+std::size_t OutlineScanner::scanDeclaration(std::string_view source, std::size_t offset, TokenType kind, bool isTopLevel)
+{
+    // The header ends at the body, at a semicolon for declarations without one, or at a stray closing brace
+    std::size_t headerEnd = offset;
+    while (headerEnd < source.size()) {
+        char c = source[headerEnd];
+        if (c == '{' || c == ';' || c == '}') {
+            break;
+        }
+        if (c == '"' || c == '\'') {
+            headerEnd = skipQuoted(source, headerEnd);
+        } else if (c == '/') {
+            headerEnd = std::max(skipComment(source, headerEnd), headerEnd + 1);
+        } else {
+            headerEnd++;
+        }
+    }
+
+    std::string_view header = source.substr(offset, headerEnd - offset);
+    mHeaderLexer.reset();
+    mHeaderLexer.buildTokens(header);
+    // The name follows the keyword, the header offsets start at 0
+    std::string_view name;
+    const std::vector<Token>& tokens = mHeaderLexer.getTokens();
+    if (tokens.size() > 1 && tokens[1].type == TokenType::IDENT) {
+        name = header.substr(tokens[1].offset, tokens[1].length);
+    }
+
+    bool hasBody = headerEnd < source.size() && source[headerEnd] == '{';
+    std::size_t end = headerEnd;
+    if (hasBody) {
+        end = skipBody(source, headerEnd);
+    } else if (headerEnd < source.size() && source[headerEnd] == ';') {
+        end = headerEnd + 1;
+    }
+    mEntries.push_back({ kind, name, offset, end - offset });
+
+    // States and handlers are only declared inside contracts and listeners, so their bodies are scanned one level deep
+    bool isContainer = kind == TokenType::K_CONTRACT || kind == TokenType::K_LISTENER;
+    if (hasBody && isTopLevel && isContainer) {
+        bool isClosed = end > headerEnd + 1 && source[end - 1] == '}';
+        scanLevel(source, headerEnd + 1, isClosed ? end - 1 : end, false);
+    }
+    return end;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "LexicalAnalyzer.hpp"
+#include "Tokens.hpp"
+
+/**
+ * A declaration at the top level or directly inside a contract or listener, from its keyword up to the end of its body
+ */
+struct OutlineEntry {
+    TokenType kind; // K_CONTRACT, K_LISTENER, K_STATE, K_FN, K_STRUCT or K_INTERFACE
+    std::string_view name; // view of the scanned source, empty when no identifier follows the keyword
+    std::uint64_t offset;
+    std::uint64_t length; // up to and including the closing brace or semicolon
+};
+
+/**
+ * Finds the declarations of a source without lexing their bodies, eg. for workspace symbol search
+ * Only the header of a declaration goes through the lexer, bodies are skipped by counting braces
+ * Strings, chars and comments are skipped whole so the braces inside them do not count
+ */
+class OutlineScanner {
+public:
+    /**
+     * Gets the declarations of the source in source order, valid until the next scan
+     * A contract or listener comes before the declarations of its body, deeper bodies are skipped
+     * Names are views of the source, which must outlive them
+     */
+    const std::vector<OutlineEntry>& scan(std::string_view source);
+
+    const std::vector<OutlineEntry>& getEntries() const { return mEntries; }
+
+    /**
+     * Whether the keyword starts a declaration listed in the outline
+     */
+    static bool isOutlineKind(TokenType type);
+
+private:
+    LexicalAnalyzer mHeaderLexer; // reused for every header so its buffers are kept
+    std::vector<OutlineEntry> mEntries;
+
+    // Adds the declarations found in [offset, end), bodies are skipped unless they are of a top level container
+    void scanLevel(std::string_view source, std::size_t offset, std::size_t end, bool isTopLevel);
+    // Adds the declaration whose keyword starts at the offset, returns the offset after it
+    std::size_t scanDeclaration(std::string_view source, std::size_t offset, TokenType kind, bool isTopLevel);
+};
@@ -0,0 +1,246 @@
+#include "ProjectLexer.hpp"
+#include "FileHandler/LexerFileReader.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+std::filesystem::path normalizePath(const std::filesystem::path& path)
+{
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    if (error) {
+        return std::filesystem::absolute(path, error).lexically_normal();
+    }
+    return canonical;
+}
+
+/**
+ * One deque of file indices per thread
+ * Owners take their newest item so a file's imports are lexed while it is still in cache, thieves take the oldest
+ */
+class WorkQueues {
+public:
+    explicit WorkQueues(std::size_t count)
+        : mQueues(count)
+    {
+    }
+
+    void push(std::size_t queue, std::size_t item)
+    {
+        mPending.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard lock { mQueues[queue].mutex };
+        mQueues[queue].items.push_back(item);
+    }
+
+    std::optional<std::size_t> pop(std::size_t queue)
+    {
+        {
+            Queue& own = mQueues[queue];
+            std::lock_guard lock { own.mutex };
+            if (!own.items.empty()) {
+                std::size_t item = own.items.back();
+                own.items.pop_back();
+                return item;
+            }
+        }
+        for (std::size_t offset = 1; offset < mQueues.size(); offset++) {
+            Queue& victim = mQueues[(queue + offset) % mQueues.size()];
+            std::lock_guard lock { victim.mutex };
+            if (!victim.items.empty()) {
+                std::size_t item = victim.items.front();
+                victim.items.pop_front();
+                return item;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Marks a popped item as done, the items it found must be pushed before
+    void finish() { mPending.fetch_sub(1, std::memory_order_acq_rel); }
+
+    bool isDone() const { return mPending.load(std::memory_order_acquire) == 0; }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::size_t> items;
+    };
+
+    std::vector<Queue> mQueues;
+    std::atomic<std::size_t> mPending { 0 }; // pushed and not yet finished
+};
+
+}
+
+std::optional<std::size_t> ProjectResult::findFile(const std::filesystem::path& path) const
+{
+    auto found = std::ranges::lower_bound(files, path, {}, &ProjectFile::path);
+    if (found == files.end() || found->path != path) {
+        return std::nullopt;
+    }
+    return static_cast<std::size_t>(found - files.begin());
+}
+
+ProjectLexer::ProjectLexer(unsigned int threadCount)
+    : mThreadCount(threadCount == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threadCount)
+    , mSymbols(std::make_shared<SymbolTable>())
+{
+}
+
+std::vector<std::string_view> ProjectLexer::getImportTargets(std::span<const Token> tokens)
+{
+    std::vector<std::string_view> targets;
+    bool isImportStatement = false;
+    for (std::size_t i = 0; i < tokens.size(); i++) {
+        switch (tokens[i].type) {
+        case TokenType::K_IMPORT:
+        case TokenType::K_EXPORT:
+        case TokenType::K_EXPORT_DEFAULT:
+            isImportStatement = true;
+            break;
+        case TokenType::D_SEMICOLON:
+            isImportStatement = false;
+            break;
+        case TokenType::K_FROM:
+            if (isImportStatement && i + 1 < tokens.size() && tokens[i + 1].type == TokenType::L_STRING) {
+                targets.push_back(tokens[i + 1].value);
+                isImportStatement = false;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return targets;
+}
+
+std::optional<std::filesystem::path> ProjectLexer::resolveImport(const std::filesystem::path& importer, std::string_view target)
+{
+    if (target.empty()) {
+        return std::nullopt;
+    }
+    std::filesystem::path candidate = importer.parent_path() / std::filesystem::path { target };
+    std::error_code error;
+    if (std::filesystem::is_regular_file(candidate, error)) {
+        return normalizePath(candidate);
+    }
+    if (!candidate.has_extension() && importer.has_extension()) {
+        candidate += importer.extension();
+        if (std::filesystem::is_regular_file(candidate, error)) {
+            return normalizePath(candidate);
+        }
+    }
+    return std::nullopt;
+}
+
+const ProjectResult& ProjectLexer::lex(std::span<const std::filesystem::path> roots)
+{
+    // The deque keeps files at a stable address while other threads add more
+    std::deque<ProjectFile> files;
+    std::unordered_map<std::string, std::size_t> indices;
+    std::mutex filesMutex;
+    WorkQueues queues { mThreadCount };
+
+    // Gets the index of the file, queueing it the first time it is seen
+    auto addFile = [&](const std::filesystem::path& path, std::size_t queue) {
+        std::lock_guard lock { filesMutex };
+        auto [found, isNew] = indices.try_emplace(path.string(), files.size());
+        if (isNew) {
+            ProjectFile& file = files.emplace_back();
+            file.path = path;
+            file.lexer.setOptions(mOptions);
+            file.lexer.setSymbolTable(mSymbols);
+            queues.push(queue, found->second);
+        }
+        return found->second;
+    };
+    auto getFile = [&](std::size_t index) -> ProjectFile& {
+        std::lock_guard lock { filesMutex };
+        return files[index];
+    };
+
+    std::vector<std::size_t> rootIndices;
+    for (std::size_t i = 0; i < roots.size(); i++) {
+        rootIndices.push_back(addFile(normalizePath(roots[i]), i % mThreadCount));
+    }
+
+    auto work = [&](std::size_t queue) {
+        while (!queues.isDone()) {
+            std::optional<std::size_t> item = queues.pop(queue);
+            if (!item.has_value()) {
+                std::this_thread::yield();
+                continue;
+            }
+            ProjectFile& file = getFile(*item);
+            TraceSpan span { "file", file.path.string() };
+            std::expected<std::string, LexFailure> source = LexerFileReader::readSource(file.path.string(), mOptions.maxBytes);
+            if (source.has_value()) {
+                file.source = std::move(*source);
+                auto lexStart = std::chrono::steady_clock::now();
+                file.lexer.buildTokens(file.source);
+                if (mMetrics != nullptr) {
+                    mMetrics->record(LexSample::of(file.lexer, file.source.size(), std::chrono::steady_clock::now() - lexStart));
+                }
+                if (mOptions.keepSymbolIndex) {
+                    file.symbolIndex = file.lexer.buildSymbolIndex();
+                }
+                for (std::string_view target : getImportTargets(file.lexer.getTokens())) {
+                    if (std::optional<std::filesystem::path> resolved = resolveImport(file.path, target)) {
+                        file.imports.push_back(addFile(*resolved, queue));
+                    } else {
+                        file.unresolved.emplace_back(target);
+                    }
+                }
+            } else {
+                file.failure = source.error().kind;
+            }
+            queues.finish();
+        }
+    };
+
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(mThreadCount - 1);
+        for (std::size_t queue = 1; queue < mThreadCount; queue++) {
+            threads.emplace_back(work, queue);
+        }
+        work(0);
+    }
+
+    // Discovery order depends on timing, ordering by path makes the result the same on every run
+    std::vector<std::size_t> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::sort(order, {}, [&files](std::size_t index) -> const std::filesystem::path& { return files[index].path; });
+    std::vector<std::size_t> newIndex(files.size());
+    for (std::size_t i = 0; i < order.size(); i++) {
+        newIndex[order[i]] = i;
+    }
+
+    mResult.files.clear();
+    mResult.files.reserve(files.size());
+    for (std::size_t index : order) {
+        ProjectFile& file = mResult.files.emplace_back(std::move(files[index]));
+        for (std::size_t& import : file.imports) {
+            import = newIndex[import];
+        }
+    }
+    mResult.roots.clear();
+    for (std::size_t index : rootIndices) {
+        mResult.roots.push_back(newIndex[index]);
+    }
+
+    std::vector<const SymbolIndex*> fileIndexes;
+    for (const ProjectFile& file : mResult.files) {
+        fileIndexes.push_back(&file.symbolIndex);
+    }
+    mResult.symbolIndex = SymbolIndex::merge(fileIndexes);
+    return mResult;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LexicalAnalyzer.hpp"
+#include "Metrics.hpp"
+#include "SymbolIndex.hpp"
+#include "SymbolTable.hpp"
+
+/**
+ * One file reached from the roots of a project
+ */
+struct ProjectFile {
+    std::filesystem::path path; // absolute, symlinks resolved
+    std::string source;
+    LexicalAnalyzer lexer; // holds the tokens of the file
+    std::vector<std::size_t> imports; // indices in ProjectResult::files, in the order they appear
+    std::vector<std::string> unresolved; // import targets with no file on disk
+    std::optional<LexFailureKind> failure; // set when the file could not be read
+    SymbolIndex symbolIndex; // empty unless LexerOptions::keepSymbolIndex is set
+};
+
+/**
+ * Files of the transitive closure of the roots and the import graph between them
+ */
+struct ProjectResult {
+    std::vector<ProjectFile> files; // ordered by path
+    std::vector<std::size_t> roots;
+    SymbolIndex symbolIndex; // every file merged, the file of an occurrence is its index in files
+
+    std::optional<std::size_t> findFile(const std::filesystem::path& path) const;
+};
+
+/**
+ * Lexes files together with everything they import
+ * Imports are read from the tokens as soon as a file is lexed and queued right away,
+ * each thread works on its own queue and steals from the others when it runs dry
+ */
+class ProjectLexer {
+public:
+    /**
+     * @param threadCount Threads used for one project, 0 for one per core
+     */
+    explicit ProjectLexer(unsigned int threadCount = 0);
+
+    /**
+     * Options given to the lexer of every file
+     */
+    void setOptions(const LexerOptions& options) { mOptions = options; }
+
+    /**
+     * Records the lex of every file, set nullptr to stop
+     */
+    void setMetrics(LexMetrics* metrics) { mMetrics = metrics; }
+
+    /**
+     * Lexes the roots and their imports, the result is valid until the next call
+     */
+    const ProjectResult& lex(std::span<const std::filesystem::path> roots);
+
+    const ProjectResult& getResult() const { return mResult; }
+    const SymbolTable& getSymbolTable() const { return *mSymbols; }
+
+    /**
+     * Gets the targets of `import ... from "target"` and `export ... from "target"` statements
+     */
+    static std::vector<std::string_view> getImportTargets(std::span<const Token> tokens);
+
+    /**
+     * Finds the file an import refers to, relative to the importing file
+     * A target without extension also matches a file with the extension of the importer
+     */
+    static std::optional<std::filesystem::path> resolveImport(const std::filesystem::path& importer, std::string_view target);
+
+private:
+    unsigned int mThreadCount;
+    LexerOptions mOptions;
+    LexMetrics* mMetrics = nullptr;
+    std::shared_ptr<SymbolTable> mSymbols; // shared by every file so ids match across the project
+    ProjectResult mResult;
+};
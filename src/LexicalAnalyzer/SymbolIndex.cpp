@@ -0,0 +1,46 @@
+#include "SymbolIndex.hpp"
+#include <algorithm>
+
+SymbolIndex::SymbolIndex(std::vector<SymbolUse> uses)
+{
+    std::ranges::stable_sort(uses, {}, &SymbolUse::symbol);
+    mOccurrences.reserve(uses.size());
+    for (const SymbolUse& use : uses) {
+        if (mSymbols.empty() || mSymbols.back() != use.symbol) {
+            mSymbols.push_back(use.symbol);
+            mStarts.push_back(static_cast<std::uint32_t>(mOccurrences.size()));
+        }
+        mOccurrences.push_back(use.occurrence);
+    }
+    mStarts.push_back(static_cast<std::uint32_t>(mOccurrences.size()));
+}
+
+std::span<const SymbolOccurrence> SymbolIndex::find(std::uint32_t symbol) const
+{
+    auto found = std::ranges::lower_bound(mSymbols, symbol);
+    if (found == mSymbols.end() || *found != symbol) {
+        return {};
+    }
+    std::size_t group = static_cast<std::size_t>(found - mSymbols.begin());
+    return std::span<const SymbolOccurrence>(mOccurrences).subspan(mStarts[group], mStarts[group + 1] - mStarts[group]);
+}
+
+SymbolIndex SymbolIndex::merge(std::span<const SymbolIndex* const> indexes)
+{
+    std::vector<SymbolUse> uses;
+    std::size_t total = 0;
+    for (const SymbolIndex* index : indexes) {
+        total += index->size();
+    }
+    uses.reserve(total);
+    for (std::size_t file = 0; file < indexes.size(); file++) {
+        const SymbolIndex& index = *indexes[file];
+        for (std::size_t group = 0; group < index.mSymbols.size(); group++) {
+            for (std::uint32_t i = index.mStarts[group]; i < index.mStarts[group + 1]; i++) {
+                uses.push_back({ index.mSymbols[group], { static_cast<std::uint32_t>(file), index.mOccurrences[i].token } });
+            }
+        }
+    }
+    // The stable sort keeps files in order, and each file already has its tokens in order
+    return SymbolIndex { std::move(uses) };
+}
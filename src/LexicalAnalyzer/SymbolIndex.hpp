@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * A token that uses a symbol
+ */
+struct SymbolOccurrence {
+    std::uint32_t file; // position of the file in a merged index, 0 for the index of one file
+    std::uint32_t token; // index in the token list of the file
+};
+
+struct SymbolUse {
+    std::uint32_t symbol;
+    SymbolOccurrence occurrence;
+};
+
+/**
+ * Inverted index from symbol id to the tokens using it, for finding usages without scanning every token
+ * Occurrences are grouped by symbol, so a lookup costs a binary search over the symbols and then only its occurrences
+ */
+class SymbolIndex {
+public:
+    SymbolIndex() = default;
+
+    /**
+     * @param uses In file then token order, which is kept within each symbol
+     */
+    explicit SymbolIndex(std::vector<SymbolUse> uses);
+
+    /**
+     * Gets where the symbol is used, ordered by file then token
+     */
+    std::span<const SymbolOccurrence> find(std::uint32_t symbol) const;
+
+    /**
+     * Gets the symbols used at least once, ordered by id
+     */
+    const std::vector<std::uint32_t>& getSymbols() const { return mSymbols; }
+
+    std::size_t size() const { return mOccurrences.size(); }
+
+    /**
+     * Combines the indexes of many files, the occurrences of each get its position in the span as file
+     * Symbol ids must come from one table, eg. the one a ProjectLexer or BatchLexer shares
+     */
+    static SymbolIndex merge(std::span<const SymbolIndex* const> indexes);
+
+private:
+    std::vector<std::uint32_t> mSymbols;
+    std::vector<std::uint32_t> mStarts; // occurrences of mSymbols[i] are [mStarts[i], mStarts[i + 1])
+    std::vector<SymbolOccurrence> mOccurrences;
+};
@@ -0,0 +1,52 @@
+#include "SymbolTable.hpp"
+#include <mutex>
+
+std::uint32_t SymbolTable::intern(std::string_view name)
+{
+    {
+        std::shared_lock lock { mMutex };
+        auto found = mIds.find(name);
+        if (found != mIds.end()) {
+            return found->second;
+        }
+    }
+
+    std::unique_lock lock { mMutex };
+    // Another thread may have added it between the two locks
+    auto found = mIds.find(name);
+    if (found != mIds.end()) {
+        return found->second;
+    }
+    std::uint32_t id = static_cast<std::uint32_t>(mNames.size());
+    const std::string& stored = mNames.emplace_back(name);
+    mIds.emplace(stored, id);
+    return id;
+}
+
+std::optional<std::uint32_t> SymbolTable::find(std::string_view name) const
+{
+    std::shared_lock lock { mMutex };
+    auto found = mIds.find(name);
+    if (found == mIds.end()) {
+        return std::nullopt;
+    }
+    return found->second;
+}
+
+std::string_view SymbolTable::getName(std::uint32_t id) const
+{
+    std::shared_lock lock { mMutex };
+    return mNames.at(id);
+}
+
+std::size_t SymbolTable::size() const
+{
+    std::shared_lock lock { mMutex };
+    return mNames.size();
+}
+
+std::vector<std::string> SymbolTable::getNames() const
+{
+    std::shared_lock lock { mMutex };
+    return { mNames.begin(), mNames.end() };
+}
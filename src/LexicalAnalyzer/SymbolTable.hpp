@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Interns identifier names into dense ids (0, 1, 2, ...)
+ * One table can be shared by lexers running on different threads
+ */
+class SymbolTable {
+public:
+    static constexpr std::uint32_t npos = UINT32_MAX;
+
+    /**
+     * Gets the id of the name, adding it if it is not yet in the table
+     */
+    std::uint32_t intern(std::string_view name);
+
+    /**
+     * Gets the id of the name without adding it
+     */
+    std::optional<std::uint32_t> find(std::string_view name) const;
+
+    /**
+     * Gets the name of an interned id
+     * The view stays valid for the lifetime of the table
+     */
+    std::string_view getName(std::uint32_t id) const;
+
+    std::size_t size() const;
+
+    /**
+     * Copies the names ordered by id
+     */
+    std::vector<std::string> getNames() const;
+
+private:
+    struct NameHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view name) const noexcept
+        {
+            return std::hash<std::string_view> {}(name);
+        }
+    };
+
+    mutable std::shared_mutex mMutex;
+    std::deque<std::string> mNames; // deque keeps the keys of mIds at a stable address
+    std::unordered_map<std::string_view, std::uint32_t, NameHash, std::equal_to<>> mIds;
+};
@@ -1,146 +1,306 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
-#include <unordered_map>
-#include <string>
-
-enum class TokenType {
-    L_INT,
-    L_FLOAT,
-    L_DOUBLE,
-    L_CHAR,
-    L_STRING,
-    L_BOOL,
-    L_URL,
-    L_PORT,
-    L_NULL,
-
-    K_LET,
-    K_TYPE,
-
-    K_IF,
-    K_ELSE,
-
-    K_FOR,
-    K_WHILE,
-    K_DO,
-    K_IN,
-    K_BREAK,
-
-    K_RET,
-    K_FN,
-
-    K_STRUCT,
-    K_INTERFACE,
-    K_IMPL,
-    K_SELF,
-    K_THIS,
-
-    K_IMPORT,
-    K_EXPORT,
-    K_EXPORT_DEFAULT,
-    K_FROM,
-
-    K_CONTRACT,
-    K_LISTENER,
-    K_STATE,
-    K_INIT_STATE,
-    K_FAIL,
-    K_AUTO_RESET,
-    K_AUTO_MOVE,
-    K_TO,
-    K_ROLES,
-    K_RESPOND,
-    K_ON,
-    K_LISTEN,
-    K_TARGET,
-    K_AS,
-    K_USING,
-    K_AFTER,
-    K_BEFORE,
-
-    K_ASYNC,
-    K_AWAIT,
-    K_THREAD,
-    K_SPAWN,
-
-    K_OWN,
-    K_MOVE,
-    K_SHARED,
-    K_VIEW,
-    K_SHARE,
-    K_REF,
-    K_MUT,
-    K_CONST,
-    K_THR_LOCAL,
-    K_SYNC,
-    K_INFER,
-    K_NETWORK,
-
-    OP_EQUALS,
-    OP_PLUS,
-    OP_MINUS,
-    OP_MULT,
-    OP_DIVIDE,
-    OP_MOD,
-    OP_PERIOD,
-
-    OP_REL_EQ,
-    OP_REL_NOT_EQ,
-    OP_REL_LESS_EQ,
-    OP_REL_GREATER_EQ,
-    OP_REL_LESS,
-    OP_REL_GREATER,
-
-    OP_PLUS_EQ,
-    OP_MINUS_EQ,
-    OP_MULT_EQ,
-    OP_DIV_EQ,
-    OP_MOD_EQ,
-
-
-    OP_AND,
-    OP_OR,
-    OP_NOT,
-
-    OP_BITW_AND,
-    OP_BITW_OR,
-    OP_BITW_XOR,
-
-    OP_SHIFT_L,
-    OP_SHIFT_R,
-
-    OP_LEFT_OP,
-    OP_RIGHT_OP,
-    OP_BIDIR_OP,
-
-    OP_INCR,
-    OP_DECR,
-
-    D_PAR_OP,
-    D_PAR_CLO,
-    D_BRAC_OP,
-    D_BRAC_CLO,
-    D_CBRAC_OP,
-    D_CBRAC_CLO,
-    D_COLON,
-    D_SEMICOLON,
-    IDENT,
-
-    // Does not need to be included in the final vector
-    NEW_LINE,
-    SPACE,
-    TAB,
-    COMMA,
-    AT_SYMBOL,
-    UNKNOWN
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string_view>
+
+/**
+ * Registry of every token type, in enum order.
+ * Expand with X(name) to generate the enum and its lookup tables.
+ * Append new entries where they belong; the C# Token.Types enum is exported from this list.
+ */
+#define SPECULA_TOKEN_TYPES(X) \
+    X(L_INT)                   \
+    X(L_FLOAT)                 \
+    X(L_DOUBLE)                \
+    X(L_CHAR)                  \
+    X(L_STRING)                \
+    X(L_BOOL)                  \
+    X(L_URL)                   \
+    X(L_PORT)                  \
+    X(L_NULL)                  \
+                               \
+    X(K_LET)                   \
+    X(K_TYPE)                  \
+                               \
+    X(K_IF)                    \
+    X(K_ELSE)                  \
+                               \
+    X(K_FOR)                   \
+    X(K_WHILE)                 \
+    X(K_DO)                    \
+    X(K_IN)                    \
+    X(K_BREAK)                 \
+                               \
+    X(K_RET)                   \
+    X(K_FN)                    \
+                               \
+    X(K_STRUCT)                \
+    X(K_INTERFACE)             \
+    X(K_IMPL)                  \
+    X(K_SELF)                  \
+    X(K_THIS)                  \
+                               \
+    X(K_IMPORT)                \
+    X(K_EXPORT)                \
+    X(K_EXPORT_DEFAULT)        \
+    X(K_FROM)                  \
+                               \
+    X(K_CONTRACT)              \
+    X(K_LISTENER)              \
+    X(K_STATE)                 \
+    X(K_INIT_STATE)            \
+    X(K_FAIL)                  \
+    X(K_AUTO_RESET)            \
+    X(K_AUTO_MOVE)             \
+    X(K_TO)                    \
+    X(K_ROLES)                 \
+    X(K_RESPOND)               \
+    X(K_ON)                    \
+    X(K_LISTEN)                \
+    X(K_TARGET)                \
+    X(K_AS)                    \
+    X(K_USING)                 \
+    X(K_AFTER)                 \
+    X(K_BEFORE)                \
+                               \
+    X(K_ASYNC)                 \
+    X(K_AWAIT)                 \
+    X(K_THREAD)                \
+    X(K_SPAWN)                 \
+                               \
+    X(K_OWN)                   \
+    X(K_MOVE)                  \
+    X(K_SHARED)                \
+    X(K_VIEW)                  \
+    X(K_SHARE)                 \
+    X(K_REF)                   \
+    X(K_MUT)                   \
+    X(K_CONST)                 \
+    X(K_THR_LOCAL)             \
+    X(K_SYNC)                  \
+    X(K_INFER)                 \
+    X(K_NETWORK)               \
+                               \
+    X(OP_EQUALS)               \
+    X(OP_PLUS)                 \
+    X(OP_MINUS)                \
+    X(OP_MULT)                 \
+    X(OP_DIVIDE)               \
+    X(OP_MOD)                  \
+    X(OP_PERIOD)               \
+                               \
+    X(OP_REL_EQ)               \
+    X(OP_REL_NOT_EQ)           \
+    X(OP_REL_LESS_EQ)          \
+    X(OP_REL_GREATER_EQ)       \
+    X(OP_REL_LESS)             \
+    X(OP_REL_GREATER)          \
+                               \
+    X(OP_PLUS_EQ)              \
+    X(OP_MINUS_EQ)             \
+    X(OP_MULT_EQ)              \
+    X(OP_DIV_EQ)               \
+    X(OP_MOD_EQ)               \
+                               \
+    X(OP_AND)                  \
+    X(OP_OR)                   \
+    X(OP_NOT)                  \
+                               \
+    X(OP_BITW_AND)             \
+    X(OP_BITW_OR)              \
+    X(OP_BITW_XOR)             \
+                               \
+    X(OP_SHIFT_L)              \
+    X(OP_SHIFT_R)              \
+                               \
+    X(OP_LEFT_OP)              \
+    X(OP_RIGHT_OP)             \
+    X(OP_BIDIR_OP)             \
+                               \
+    X(OP_INCR)                 \
+    X(OP_DECR)                 \
+                               \
+    X(D_PAR_OP)                \
+    X(D_PAR_CLO)               \
+    X(D_BRAC_OP)               \
+    X(D_BRAC_CLO)              \
+    X(D_CBRAC_OP)              \
+    X(D_CBRAC_CLO)             \
+    X(D_COLON)                 \
+    X(D_SEMICOLON)             \
+    X(IDENT)                   \
+                               \
+    /* Does not need to be included in the final vector */ \
+    X(NEW_LINE)                \
+    X(SPACE)                   \
+    X(TAB)                     \
+    X(COMMA)                   \
+    X(AT_SYMBOL)               \
+    X(UNKNOWN)
+
+/**
+ * Reserved words and the token each one produces.
+ * Several spellings may map to the same token (eg. the builtin types).
+ */
+#define SPECULA_KEYWORDS(X)               \
+    X("let", K_LET)                       \
+    X("int", K_TYPE)                      \
+    X("float", K_TYPE)                    \
+    X("double", K_TYPE)                   \
+    X("bool", K_TYPE)                     \
+    X("char", K_TYPE)                     \
+    X("void", K_TYPE)                     \
+    X("null", L_NULL)                     \
+    X("if", K_IF)                         \
+    X("else", K_ELSE)                     \
+    X("for", K_FOR)                       \
+    X("while", K_WHILE)                   \
+    X("do", K_DO)                         \
+    X("in", K_IN)                         \
+    X("break", K_BREAK)                   \
+    X("ret", K_RET)                       \
+    X("fn", K_FN)                         \
+    X("struct", K_STRUCT)                 \
+    X("interface", K_INTERFACE)           \
+    X("impl", K_IMPL)                     \
+    X("self", K_SELF)                     \
+    X("this", K_THIS)                     \
+    X("import", K_IMPORT)                 \
+    X("export", K_EXPORT)                 \
+    X("export_default", K_EXPORT_DEFAULT) \
+    X("from", K_FROM)                     \
+    X("contract", K_CONTRACT)             \
+    X("listener", K_LISTENER)             \
+    X("state", K_STATE)                   \
+    X("init-state", K_INIT_STATE)         \
+    X("fail", K_FAIL)                     \
+    X("auto-reset", K_AUTO_RESET)         \
+    X("auto-move", K_AUTO_MOVE)           \
+    X("to", K_TO)                         \
+    X("roles", K_ROLES)                   \
+    X("respond", K_RESPOND)               \
+    X("on", K_ON)                         \
+    X("listen", K_LISTEN)                 \
+    X("target", K_TARGET)                 \
+    X("as", K_AS)                         \
+    X("using", K_USING)                   \
+    X("after", K_AFTER)                   \
+    X("before", K_BEFORE)                 \
+    X("async", K_ASYNC)                   \
+    X("await", K_AWAIT)                   \
+    X("thread", K_THREAD)                 \
+    X("spawn", K_SPAWN)                   \
+    X("own", K_OWN)                       \
+    X("move", K_MOVE)                     \
+    X("shared", K_SHARED)                 \
+    X("share", K_SHARE)                   \
+    X("ref", K_REF)                       \
+    X("view", K_VIEW)                     \
+    X("mut", K_MUT)                       \
+    X("const", K_CONST)                   \
+    X("thr_local", K_THR_LOCAL)           \
+    X("sync", K_SYNC)                     \
+    X("infer", K_INFER)                   \
+    X("network", K_NETWORK)
+
+enum class TokenType : std::uint8_t {
+#define SPECULA_TOKEN_ENUM(name) name,
+    SPECULA_TOKEN_TYPES(SPECULA_TOKEN_ENUM)
+#undef SPECULA_TOKEN_ENUM
 };
 
+namespace TokenRegistry {
 
-struct TokenTypeHash {
-    std::size_t operator()(const TokenType& t) const noexcept {
-        return static_cast<std::size_t>(t);
-    }
+#define SPECULA_TOKEN_COUNT(name) +1
+inline constexpr std::size_t tokenTypeCount = 0 SPECULA_TOKEN_TYPES(SPECULA_TOKEN_COUNT);
+#undef SPECULA_TOKEN_COUNT
+
+/**
+ * Names indexed by the enum value
+ */
+inline constexpr std::array<std::string_view, tokenTypeCount> tokenTypeNames = {
+#define SPECULA_TOKEN_NAME(name) #name,
+    SPECULA_TOKEN_TYPES(SPECULA_TOKEN_NAME)
+#undef SPECULA_TOKEN_NAME
 };
 
-extern const std::unordered_map<TokenType, std::string, TokenTypeHash> tokenTypeToString; 
+struct NamedToken {
+    std::string_view name;
+    TokenType type;
+};
+
+struct KeywordEntry {
+    std::string_view spelling;
+    TokenType type;
+};
+
+// Sorted by name for the reverse lookup
+inline constexpr auto sortedTokenTypeNames = [] {
+    std::array<NamedToken, tokenTypeCount> table {};
+    for (std::size_t i = 0; i < tokenTypeCount; i++) {
+        table[i] = { tokenTypeNames[i], static_cast<TokenType>(i) };
+    }
+    std::ranges::sort(table, {}, &NamedToken::name);
+    return table;
+}();
+
+// Sorted by spelling so lookups are a binary search
+inline constexpr auto keywordTable = [] {
+    std::array table {
+#define SPECULA_KEYWORD_ENTRY(spelling, name) KeywordEntry { spelling, TokenType::name },
+        SPECULA_KEYWORDS(SPECULA_KEYWORD_ENTRY)
+#undef SPECULA_KEYWORD_ENTRY
+    };
+    std::ranges::sort(table, {}, &KeywordEntry::spelling);
+    return table;
+}();
+
+static_assert(tokenTypeCount <= 256, "TokenType is stored in a byte");
+static_assert(std::ranges::adjacent_find(keywordTable, {}, &KeywordEntry::spelling) == keywordTable.end(),
+    "Keyword is listed twice");
+
+}
+
+/**
+ * Gets the registry name of the token type (eg. "K_LET")
+ */
+constexpr std::string_view tokenTypeToString(TokenType type)
+{
+    return TokenRegistry::tokenTypeNames[static_cast<std::size_t>(type)];
+}
+
+/**
+ * Gets the token type from its registry name
+ */
+constexpr std::optional<TokenType> tokenTypeFromString(std::string_view name)
+{
+    const auto& table = TokenRegistry::sortedTokenTypeNames;
+    auto found = std::ranges::lower_bound(table, name, {}, &TokenRegistry::NamedToken::name);
+    if (found == table.end() || found->name != name) {
+        return std::nullopt;
+    }
+    return found->type;
+}
+
+/**
+ * Gets the token type of a reserved word
+ */
+constexpr std::optional<TokenType> keywordFromString(std::string_view spelling)
+{
+    const auto& table = TokenRegistry::keywordTable;
+    auto found = std::ranges::lower_bound(table, spelling, {}, &TokenRegistry::KeywordEntry::spelling);
+    if (found == table.end() || found->spelling != spelling) {
+        return std::nullopt;
+    }
+    return found->type;
+}
+
+/**
+ * Writes the registry as the C# Token.Types enum used by the syntax analyzer
+ */
+void writeCSharpTokenTypes(std::ostream& out);
@@ -0,0 +1,138 @@
+#include "Trace.hpp"
+#include <cstdio>
+#include <utility>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    std::string detail;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+};
+
+struct ThreadBuffer {
+    std::uint32_t thread; // sequential, in the order threads first recorded
+    std::vector<TraceEvent> events;
+};
+
+/**
+ * Owns the buffers so they outlive their threads, eg. the workers of a ProjectLexer
+ */
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::atomic<std::uint64_t> generation { 0 }; // bumped by start so threads drop buffers of an earlier trace
+    std::chrono::steady_clock::time_point origin;
+};
+
+TraceRegistry& getRegistry()
+{
+    static TraceRegistry registry;
+    return registry;
+}
+
+ThreadBuffer* addThreadBuffer()
+{
+    TraceRegistry& registry = getRegistry();
+    std::lock_guard lock { registry.mutex };
+    ThreadBuffer* buffer = registry.buffers.emplace_back(std::make_unique<ThreadBuffer>()).get();
+    buffer->thread = static_cast<std::uint32_t>(registry.buffers.size());
+    return buffer;
+}
+
+void writeEscaped(std::FILE* file, std::string_view text)
+{
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', file);
+            std::fputc(c, file);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            std::fprintf(file, "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+        } else {
+            std::fputc(c, file);
+        }
+    }
+}
+
+double toMicroseconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+}
+
+std::atomic<bool> Trace::mIsEnabled { false };
+
+void Trace::start()
+{
+    TraceRegistry& registry = getRegistry();
+    std::lock_guard lock { registry.mutex };
+    registry.buffers.clear();
+    registry.generation.fetch_add(1, std::memory_order_release);
+    registry.origin = std::chrono::steady_clock::now();
+    mIsEnabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::record(const char* name, std::string detail, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    // Only the first span of a thread takes the lock
+    thread_local ThreadBuffer* buffer = nullptr;
+    thread_local std::uint64_t bufferGeneration = 0;
+    std::uint64_t generation = getRegistry().generation.load(std::memory_order_acquire);
+    if (buffer == nullptr || bufferGeneration != generation) {
+        buffer = addThreadBuffer();
+        bufferGeneration = generation;
+    }
+    buffer->events.push_back({ name, std::move(detail), start, end });
+}
+
+bool Trace::write(const std::filesystem::path& path)
+{
+    mIsEnabled.store(false, std::memory_order_relaxed);
+    std::FILE* file = std::fopen(path.string().c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    TraceRegistry& registry = getRegistry();
+    std::lock_guard lock { registry.mutex };
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+    bool isFirst = true;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : registry.buffers) {
+        std::fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+            isFirst ? "" : ",", buffer->thread, buffer->thread);
+        isFirst = false;
+        for (const TraceEvent& event : buffer->events) {
+            std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"specula\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                event.name, buffer->thread, toMicroseconds(event.start - registry.origin), toMicroseconds(event.end - event.start));
+            if (!event.detail.empty()) {
+                std::fputs(",\"args\":{\"detail\":\"", file);
+                writeEscaped(file, event.detail);
+                std::fputs("\"}", file);
+            }
+            std::fputc('}', file);
+        }
+    }
+    std::fputs("\n]}\n", file);
+    return std::fclose(file) == 0;
+}
+
+TraceSpan::TraceSpan(const char* name, std::string_view detail)
+{
+    if (Trace::isEnabled()) {
+        mName = name;
+        mDetail = detail;
+        mStart = std::chrono::steady_clock::now();
+    }
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (mName != nullptr) {
+        Trace::record(mName, std::move(mDetail), mStart, std::chrono::steady_clock::now());
+    }
+}
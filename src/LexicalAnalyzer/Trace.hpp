@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+/**
+ * Timeline of named spans per thread, written in the Chrome trace event format (chrome://tracing, ui.perfetto.dev)
+ * Off until started, a span then costs one relaxed load
+ * Every thread appends to its own buffer without locking, buffers are only read when writing
+ */
+class Trace {
+public:
+    /**
+     * Starts recording, dropping what was recorded before
+     */
+    static void start();
+
+    /**
+     * Stops recording and writes every span, threads still recording must have finished
+     *
+     * @return false if the file could not be written
+     */
+    static bool write(const std::filesystem::path& path);
+
+    static bool isEnabled() { return mIsEnabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Adds a span to the calling thread's buffer
+     *
+     * @param name Must outlive the trace, eg. a string literal
+     * @param detail Shown in the span's args, eg. the file it worked on
+     */
+    static void record(const char* name, std::string detail, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+private:
+    static std::atomic<bool> mIsEnabled;
+};
+
+/**
+ * Records the time from its construction to its destruction as one span
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, std::string_view detail = {});
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* mName = nullptr; // nullptr when the trace was off at construction
+    std::string mDetail;
+    std::chrono::steady_clock::time_point mStart;
+};
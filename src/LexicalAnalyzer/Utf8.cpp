@@ -0,0 +1,86 @@
+#include "Utf8.hpp"
+#include <bit>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+bool isInRange(unsigned char byte, unsigned char low, unsigned char high)
+{
+    return byte >= low && byte <= high;
+}
+
+// Bytes of the non-ASCII character at data, 0 if it is malformed, overlong, a surrogate or above U+10FFFF
+std::size_t getValidSequenceLength(const unsigned char* data, std::size_t available)
+{
+    std::size_t length = Utf8::getSequenceLength(static_cast<char>(data[0]));
+    if (length == 0 || length > available) {
+        return 0;
+    }
+
+    // The second byte has a narrower range after some leads
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    switch (data[0]) {
+    case 0xE0:
+        low = 0xA0;
+        break;
+    case 0xED:
+        high = 0x9F;
+        break;
+    case 0xF0:
+        low = 0x90;
+        break;
+    case 0xF4:
+        high = 0x8F;
+        break;
+    }
+    if (!isInRange(data[1], low, high)) {
+        return 0;
+    }
+    for (std::size_t i = 2; i < length; i++) {
+        if (!isInRange(data[i], 0x80, 0xBF)) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+}
+
+std::size_t Utf8::findInvalid(std::string_view text, std::size_t from)
+{
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(text.data());
+    std::size_t size = text.size();
+    std::size_t i = from;
+
+    while (i < size) {
+#if defined(__SSE2__)
+        // The sign bits of a chunk are all clear when it is ASCII
+        while (i + 16 <= size) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(chunk));
+            if (mask != 0) {
+                i += std::countr_zero(mask);
+                break;
+            }
+            i += 16;
+        }
+        if (i >= size) {
+            break;
+        }
+#endif
+        if (data[i] < 0x80) {
+            i++;
+            continue;
+        }
+        std::size_t length = getValidSequenceLength(data + i, size - i);
+        if (length == 0) {
+            return i;
+        }
+        i += length;
+    }
+    return std::string_view::npos;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace Utf8 {
+
+/**
+ * Finds the first byte at or after from that does not start a well formed UTF-8 character
+ * Runs of ASCII are skipped 16 bytes at a time
+ *
+ * @return Index in the text, or std::string_view::npos when the rest is valid
+ */
+std::size_t findInvalid(std::string_view text, std::size_t from = 0);
+
+constexpr bool isContinuation(char c)
+{
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+/**
+ * Gets the bytes of the character that starts with lead, 0 if it cannot start one
+ */
+constexpr std::size_t getSequenceLength(char lead)
+{
+    unsigned char byte = static_cast<unsigned char>(lead);
+    if (byte < 0x80) {
+        return 1;
+    }
+    if (byte >= 0xC2 && byte <= 0xDF) {
+        return 2;
+    }
+    if (byte >= 0xE0 && byte <= 0xEF) {
+        return 3;
+    }
+    if (byte >= 0xF0 && byte <= 0xF4) {
+        return 4;
+    }
+    return 0;
+}
+
+/**
+ * Gets the code point of one well formed character
+ */
+constexpr char32_t decode(std::string_view character)
+{
+    std::size_t length = getSequenceLength(character.front());
+    if (length <= 1) {
+        return static_cast<unsigned char>(character.front());
+    }
+    char32_t value = static_cast<unsigned char>(character.front()) & (0x7F >> length);
+    for (std::size_t i = 1; i < length; i++) {
+        value = (value << 6) | (static_cast<unsigned char>(character[i]) & 0x3F);
+    }
+    return value;
+}
+
+}
@@ -0,0 +1,64 @@
+#include "FileHandler/TokenRing.hpp"
+#include "Tokens.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <print>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// Reference consumer of `specula --ring name`, prints a summary of every file as soon as its last token arrives
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::print("Usage: ./specula-ring-consumer [name]\n");
+        return 1;
+    }
+
+    // The producer may not have made the ring yet
+    std::optional<TokenRingReader> reader;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds { 10 };
+    while (!reader.has_value()) {
+        try {
+            reader.emplace(argv[1]);
+        } catch (const std::invalid_argument& iErr) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                std::print("{}\n", iErr.what());
+                return 1;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds { 10 });
+        }
+    }
+
+    std::array<TokenRecord, 256> records;
+    std::size_t file = 0;
+    std::uint64_t tokenCount = 0;
+    std::uint64_t identCount = 0;
+    while (true) {
+        std::size_t count = reader->read(records);
+        if (count == 0) {
+            if (reader->isFinished()) {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        for (const TokenRecord& record : std::span { records }.first(count)) {
+            if (record.type == TokenRecord::endOfFile) {
+                std::print("file {}: {} bytes, {} tokens, {} identifiers\n", file, record.offset, tokenCount, identCount);
+                file++;
+                tokenCount = 0;
+                identCount = 0;
+                continue;
+            }
+            tokenCount++;
+            if (static_cast<TokenType>(record.type) == TokenType::IDENT) {
+                identCount++;
+            }
+        }
+    }
+    return 0;
+}
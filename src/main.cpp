@@ -1,34 +1,444 @@
-#include "LexerError.hpp"
+#include "BatchLexer.hpp"
+#include "FileHandler/LexerBatchReader.hpp"
+#include "FileHandler/LexerBatchWriter.hpp"
+#include "FileHandler/LexerFileChecker.hpp"
 #include "FileHandler/LexerFileReader.hpp"
+#include "FileHandler/LexerFilePipeline.hpp"
 #include "FileHandler/LexerFileWriter.hpp"
+#include "FileHandler/LexerHighlightWriter.hpp"
+#include "FileHandler/LexerOutlineWriter.hpp"
+#include "FileHandler/LexerProjectWriter.hpp"
+#include "FileHandler/LexerWatcher.hpp"
+#include "FileHandler/TokenRing.hpp"
 #include "LexicalAnalyzer.hpp"
+#include "Metrics.hpp"
+#include "OutlineScanner.hpp"
+#include "ProjectLexer.hpp"
+#include "Tokens.hpp"
+#include "Trace.hpp"
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <optional>
 #include <print>
+#include <ranges>
+#include <span>
 #include <stdexcept>
+#include <string_view>
+
+struct LineRange {
+    std::uint64_t first;
+    std::uint64_t last;
+};
+
+// Writes the trace when main returns, whichever mode ran
+struct TraceFile {
+    std::optional<std::filesystem::path> path;
+
+    ~TraceFile()
+    {
+        if (path.has_value() && !Trace::write(*path)) {
+            std::print("Cannot write file: {}\n", path->string());
+        }
+    }
+};
+
+// Parses "first:last", lines start at 1 and last is excluded
+static std::optional<LineRange> parseLineRange(std::string_view text)
+{
+    std::size_t colon = text.find(':');
+    if (colon == std::string_view::npos) {
+        return std::nullopt;
+    }
+    LineRange range;
+    auto [firstEnd, firstErr] = std::from_chars(text.data(), text.data() + colon, range.first);
+    auto [lastEnd, lastErr] = std::from_chars(text.data() + colon + 1, text.data() + text.size(), range.last);
+    if (firstErr != std::errc {} || lastErr != std::errc {} || firstEnd != text.data() + colon || lastEnd != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return range;
+}
+
+static std::optional<std::uint64_t> parseCount(std::string_view text)
+{
+    std::uint64_t value = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc {} || end != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
 
 int main(int argc, char** argv)
 {
     if (argc < 2) {
-        std::print("Usage: ./specula [filePath] ...");
+        std::print("Usage: ./specula [--lines first:last | --highlight] [--trivia] [--symbol-index] [--brackets] [filePath] ...\n"
+                   "       ./specula --pipeline [filePath] ...\n"
+                   "       ./specula --outline [filePath] ...\n"
+                   "       ./specula --check [--all-errors] [filePath] ...\n"
+                   "       ./specula --project [rootPath] ...\n"
+                   "       ./specula --ring [name] [--ring-replace] [filePath] ...\n"
+                   "       ./specula --watch [directory] [--watch-extensions .spc,...]\n"
+                   "Limits: --max-bytes n --max-tokens n --max-errors n --time-limit-ms n\n"
+                   "Metrics: --metrics [file.prom | -]\n"
+                   "Trace: --trace [file.json] (chrome://tracing or ui.perfetto.dev)\n"
+                   "Output: --json-threads n (0 for one per core)\n"
+                   "       ./specula --batch [sources.json] ...\n"
+                   "       ./specula --export-token-table [Tokens.g.cs]\n");
     }
     std::vector<std::string> files;
+    std::optional<LineRange> lineRange;
+    bool isBatch = false;
+    bool isPipeline = false;
+    bool isProject = false;
+    bool isOutline = false;
+    bool isCheck = false;
+    bool isCollectingAllErrors = false;
+    std::optional<std::string> watchDirectory;
+    std::vector<std::string> watchExtensions;
+    std::optional<std::string> ringName;
+    bool isReplacingRing = false;
+    std::optional<unsigned int> jsonThreads;
+    bool isHighlight = false;
+    LexerOptions options;
+    std::optional<std::string> metricsPath;
+    TraceFile traceFile;
     files.reserve(argc);
     for (int i = 1; i < argc; i++) {
+        std::string_view arg { argv[i] };
+        if (arg == "--export-token-table" && i + 1 < argc) {
+            std::ofstream tableFile { argv[++i] };
+            writeCSharpTokenTypes(tableFile);
+            continue;
+        }
+        if (arg == "--lines" && i + 1 < argc) {
+            lineRange = parseLineRange(argv[++i]);
+            if (!lineRange.has_value()) {
+                std::print("Invalid line range: {}, expected first:last\n", argv[i]);
+                return 1;
+            }
+            continue;
+        }
+        if (arg == "--batch") {
+            isBatch = true;
+            continue;
+        }
+        bool isLimit = arg == "--max-bytes" || arg == "--max-tokens" || arg == "--max-errors" || arg == "--time-limit-ms";
+        if (isLimit && i + 1 < argc) {
+            std::optional<std::uint64_t> value = parseCount(argv[++i]);
+            if (!value.has_value()) {
+                std::print("Invalid value for {}: {}\n", arg, argv[i]);
+                return 1;
+            }
+            if (arg == "--max-bytes") {
+                options.maxBytes = *value;
+            } else if (arg == "--max-tokens") {
+                options.maxTokens = *value;
+            } else if (arg == "--max-errors") {
+                options.maxErrors = *value;
+            } else {
+                options.timeLimit = std::chrono::milliseconds { *value };
+            }
+            continue;
+        }
+        if (arg == "--json-threads" && i + 1 < argc) {
+            std::optional<std::uint64_t> value = parseCount(argv[++i]);
+            if (!value.has_value()) {
+                std::print("Invalid value for {}: {}\n", arg, argv[i]);
+                return 1;
+            }
+            jsonThreads = static_cast<unsigned int>(*value);
+            continue;
+        }
+        if (arg == "--metrics" && i + 1 < argc) {
+            metricsPath = argv[++i];
+            continue;
+        }
+        if (arg == "--trace" && i + 1 < argc) {
+            traceFile.path = argv[++i];
+            Trace::start();
+            continue;
+        }
+        if (arg == "--trivia") {
+            options.keepTrivia = true;
+            continue;
+        }
+        if (arg == "--symbol-index") {
+            options.keepSymbolIndex = true;
+            continue;
+        }
+        if (arg == "--brackets") {
+            options.keepBracketMatches = true;
+            continue;
+        }
+        if (arg == "--highlight") {
+            isHighlight = true;
+            continue;
+        }
+        if (arg == "--pipeline") {
+            isPipeline = true;
+            continue;
+        }
+        if (arg == "--watch" && i + 1 < argc) {
+            watchDirectory = argv[++i];
+            continue;
+        }
+        if (arg == "--watch-extensions" && i + 1 < argc) {
+            for (auto extension : std::views::split(std::string_view { argv[++i] }, ',')) {
+                watchExtensions.emplace_back(std::string_view { extension });
+            }
+            continue;
+        }
+        if (arg == "--outline") {
+            isOutline = true;
+            continue;
+        }
+        if (arg == "--check") {
+            isCheck = true;
+            continue;
+        }
+        if (arg == "--all-errors") {
+            isCollectingAllErrors = true;
+            continue;
+        }
+        if (arg == "--ring" && i + 1 < argc) {
+            ringName = argv[++i];
+            continue;
+        }
+        if (arg == "--ring-replace") {
+            isReplacingRing = true;
+            continue;
+        }
+        if (arg == "--project") {
+            isProject = true;
+            continue;
+        }
         files.push_back(argv[i]);
     }
+    // The pipeline only writes full _tokens outputs
+    if (isPipeline && (lineRange.has_value() || isHighlight)) {
+        std::print("--pipeline cannot be combined with --lines or --highlight\n");
+        return 1;
+    }
+
+    LexMetrics metrics;
+    auto writeMetrics = [&metrics, &metricsPath] {
+        if (metricsPath.has_value()) {
+            metrics.writePrometheus(std::filesystem::path { *metricsPath });
+        }
+    };
+
+    // Every file is a JSON array of sources, lexed together
+    if (isBatch) {
+        BatchLexer batchLexer;
+        for (const std::string& file : files) {
+            try {
+                auto lexStart = std::chrono::steady_clock::now();
+                LexerBatchReader lexerBatchReader { batchLexer, file };
+                std::uint64_t bytes = 0;
+                for (const std::string& source : lexerBatchReader.getSources()) {
+                    bytes += source.size();
+                }
+                const BatchResult& result = batchLexer.getResult();
+                metrics.record({ bytes, result.tokens.size(), result.errors.size(), false, std::chrono::steady_clock::now() - lexStart });
+                LexerBatchWriter lexerBatchWriter { batchLexer, lexerBatchReader.getSources(), file };
+            } catch (const std::invalid_argument& iErr) {
+                std::print("{}\n", iErr.what());
+            }
+        }
+        writeMetrics();
+        return 0;
+    }
+
+    // Keeps the tree lexed, printing the path of every output as it is written
+    if (watchDirectory.has_value()) {
+        LexerWatcher watcher { *watchDirectory, options };
+        watcher.setMetrics(&metrics);
+        if (!watchExtensions.empty()) {
+            watcher.setExtensions(watchExtensions);
+        }
+        auto writeChanges = [&watcher](const std::vector<WatchChange>& changes) {
+            for (const WatchChange& change : changes) {
+                std::string file = change.path.string();
+                std::filesystem::path outputPath = LexerFileWriter::getOutputPath(file);
+                if (change.isRemoved) {
+                    std::error_code error;
+                    std::filesystem::remove(outputPath, error);
+                    if (change.failure.has_value()) {
+                        std::print("Cannot read file: {}\n", file);
+                    }
+                    continue;
+                }
+                // One file that cannot be written must not stop the watch
+                try {
+                    const WatchedFile* watched = watcher.findFile(change.path);
+                    std::ofstream output { outputPath };
+                    output << LexerFileWriter::serialize(watched->lexer, LineIndex { watched->source }, file);
+                    if (!output) {
+                        std::print("Cannot write file: {}\n", outputPath.string());
+                        continue;
+                    }
+                    std::print("{}\n", outputPath.string());
+                } catch (const std::exception& exception) {
+                    std::print("Cannot write file: {}: {}\n", outputPath.string(), exception.what());
+                }
+            }
+            std::fflush(stdout);
+        };
+        writeChanges(watcher.lexAll());
+        writeMetrics();
+        while (true) {
+            std::vector<WatchChange> changes = watcher.poll(std::chrono::seconds { 1 });
+            if (!changes.empty()) {
+                writeChanges(changes);
+                writeMetrics();
+            }
+        }
+    }
+
+    // Follows the imports of the given files, lexing every file reached
+    if (isProject) {
+        ProjectLexer projectLexer;
+        projectLexer.setOptions(options);
+        projectLexer.setMetrics(&metrics);
+        std::vector<std::filesystem::path> roots { files.begin(), files.end() };
+        const ProjectResult& result = projectLexer.lex(roots);
+        for (const ProjectFile& file : result.files) {
+            if (file.failure.has_value()) {
+                std::print("Cannot read file: {}\n", file.path.string());
+            }
+        }
+        LexerProjectWriter lexerProjectWriter { projectLexer };
+        writeMetrics();
+        return 0;
+    }
+
+    // Only the declarations, their bodies are skipped without lexing
+    if (isOutline) {
+        OutlineScanner scanner;
+        for (const std::string& file : files) {
+            std::expected<std::string, LexFailure> source = LexerFileReader::readSource(file, 0);
+            if (!source.has_value()) {
+                std::print("Cannot read file: {}\n", file);
+                continue;
+            }
+            LexerOutlineWriter lexerOutlineWriter { scanner.scan(*source), LineIndex { *source }, file };
+        }
+        return 0;
+    }
+
+    // Only reports errors, for pre-commit hooks and CI, nothing is written
+    if (isCheck) {
+        static constexpr std::array<std::string_view, 4> limitNames = { "bytes", "tokens", "errors", "time" };
+        LexerFileChecker checker { options };
+        checker.setCollectingAllErrors(isCollectingAllErrors);
+        for (const FileCheck& result : checker.check(files)) {
+            for (const CheckError& error : result.errors) {
+                std::print("{}:{}:{}: {}\n", result.path, error.position.line, error.position.column, error.message);
+            }
+            if (!result.failure.has_value()) {
+                continue;
+            }
+            if (result.failure->truncation.has_value()) {
+                const LexerTruncation& truncation = *result.failure->truncation;
+                std::print("{}: not checked past byte {}, the {} limit was reached\n", result.path, truncation.offset, limitNames[static_cast<std::size_t>(truncation.limit)]);
+            } else {
+                bool isOpenError = result.failure->kind == LexFailureKind::CANNOT_OPEN;
+                std::print("{}{}\n", isOpenError ? "Cannot open file: " : "Cannot read file: ", result.path);
+            }
+        }
+        return checker.getExitCode();
+    }
 
     LexicalAnalyzer lexer;
+    lexer.setOptions(options);
 
-    for (const std::string& file : files) {
+    // Tokens go to a consumer process through shared memory as they are lexed, no file is written
+    if (ringName.has_value()) {
+        std::optional<TokenRingWriter> ring;
         try {
-            LexerFileReader lexerFileReader { lexer, file };
-        } catch (const LexerError& error) {
-            std::print("Lexer Error at line {}:{}\n Message: {}\n", error.getLine(), error.getCharPos(), error.what());
+            ring.emplace(*ringName, std::size_t { 1 } << 16, isReplacingRing);
         } catch (const std::invalid_argument& iErr) {
             std::print("{}\n", iErr.what());
+            return 1;
         }
-        if (!lexer.getTokens().empty()) {
-            LexerFileWriter lexerFileWriter { lexer, file };
+        lexer.setTokenCallback([&ring](std::span<const Token> tokens) { ring->write(tokens); });
+        for (const std::string& file : files) {
+            TraceSpan fileSpan { "file", file };
+            // Every file ends with a record, even one that cannot be read, so the consumer can count them
+            std::uint64_t sourceSize = 0;
+            try {
+                auto lexStart = std::chrono::steady_clock::now();
+                LexerFileReader lexerFileReader { lexer, file };
+                sourceSize = lexerFileReader.getSource().size();
+                metrics.record(LexSample::of(lexer, sourceSize, std::chrono::steady_clock::now() - lexStart));
+            } catch (const std::invalid_argument& iErr) {
+                std::print("{}\n", iErr.what());
+            }
+            ring->endFile(sourceSize);
             lexer.reset();
+            if (ring->getError().has_value()) {
+                break;
+            }
+        }
+        ring->close();
+        ring->waitUntilRead();
+        writeMetrics();
+        if (ring->getError() == TokenRingError::CONSUMER_GONE) {
+            std::print("Ring consumer detached before reading every token: {}\n", *ringName);
+            return 1;
+        }
+        if (ring->getError() == TokenRingError::TIMED_OUT) {
+            std::print("Ring consumer did not read for {} ms: {}\n", ring->getTimeout().count(), *ringName);
+            return 1;
+        }
+        return 0;
+    }
+
+    // Reads ahead and writes behind while lexing, the outputs are the same
+    if (isPipeline) {
+        LexerFilePipeline pipeline { lexer };
+        pipeline.setMetrics(&metrics);
+        pipeline.run(files, [](const std::string& message) { std::print("{}\n", message); });
+        writeMetrics();
+        return 0;
+    }
+
+    for (const std::string& file : files) {
+        TraceSpan fileSpan { "file", file };
+        std::optional<LexerFileReader> lexerFileReader;
+        try {
+            // Includes reading the file, usually from the page cache
+            auto lexStart = std::chrono::steady_clock::now();
+            lexerFileReader.emplace(lexer, file);
+            metrics.record(LexSample::of(lexer, lexerFileReader->getSource().size(), std::chrono::steady_clock::now() - lexStart));
+        } catch (const std::invalid_argument& iErr) {
+            std::print("{}\n", iErr.what());
+        }
+        bool hasOutput = !lexer.getTokens().empty() || (isHighlight && !lexer.getComments().empty());
+        if (lexerFileReader.has_value() && hasOutput) {
+            const LineIndex& lines = lexerFileReader->getLineIndex();
+            if (isHighlight) {
+                LexerHighlightWriter lexerHighlightWriter { lexer, lines, file };
+            } else {
+                std::span<const Token> tokens = lexer.getTokens();
+                if (lineRange.has_value()) {
+                    tokens = lexer.getTokensInLines(lines, lineRange->first, lineRange->last);
+                }
+                if (jsonThreads.has_value()) {
+                    if (!LexerFileWriter::writeParallel(lexer, lines, file, tokens, *jsonThreads)) {
+                        std::print("Cannot write file: {}\n", LexerFileWriter::getOutputPath(file).string());
+                    }
+                } else {
+                    LexerFileWriter lexerFileWriter { lexer, lines, file, tokens };
+                }
+            }
         }
+        lexer.reset();
     }
+    writeMetrics();
 }
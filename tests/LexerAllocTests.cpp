@@ -0,0 +1,118 @@
+#include <atomic>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LexicalAnalyzer.hpp"
+
+// Every allocation of the process goes through these, the tests only look at the count around one lex
+namespace {
+
+std::atomic<std::size_t> allocationCount { 0 };
+
+void* allocate(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants the size to be a multiple of the alignment
+    std::size_t rounded = (size + align - 1) / align * align;
+    if (void* memory = std::aligned_alloc(align, rounded == 0 ? align : rounded)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+}
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+
+namespace {
+
+// Long identifiers and strings do not fit in a string inline, dashes and bad characters add more tokens and errors
+constexpr std::string_view validSource = "let contract_with_a_long_name: int = 123456789;\n"
+                                         "/* comment */ let url = \"https://example.com:8080/some/long/path\";\n"
+                                         "auto-generated_identifier_name += 3.14159f; // trailing\n"
+                                         "if (a_rather_long_condition_name && b || c) { x++; } else { y--; }\n";
+constexpr std::string_view invalidSource = "let broken = 1.2.3; let c = 'ab'; \"unterminated string literal\n"
+                                           "let value = 99999999999999999999999; # $ ~\n";
+
+}
+
+class LexerAllocTest : public testing::Test {
+protected:
+    LexicalAnalyzer mLexer;
+
+    // Lexes the text into the reused lexer and counts the allocations it made
+    std::size_t countLexAllocations(std::string_view text)
+    {
+        mLexer.reset();
+        std::size_t before = allocationCount.load(std::memory_order_relaxed);
+        mLexer.buildTokens(text);
+        return allocationCount.load(std::memory_order_relaxed) - before;
+    }
+};
+
+TEST_F(LexerAllocTest, REUSED_LEXER)
+{
+    EXPECT_GT(countLexAllocations(validSource), 0u);
+    std::vector<Token> firstTokens = mLexer.getTokens();
+
+    EXPECT_EQ(countLexAllocations(validSource), 0u);
+    ASSERT_EQ(mLexer.getTokens().size(), firstTokens.size());
+    for (std::size_t i = 0; i < firstTokens.size(); i++) {
+        EXPECT_EQ(mLexer.getTokens()[i].value, firstTokens[i].value);
+        EXPECT_EQ(mLexer.getTokens()[i].offset, firstTokens[i].offset);
+    }
+}
+
+TEST_F(LexerAllocTest, ERRORS)
+{
+    countLexAllocations(invalidSource);
+    ASSERT_FALSE(mLexer.getErrors().empty());
+    std::size_t errorCount = mLexer.getErrors().size();
+
+    EXPECT_EQ(countLexAllocations(invalidSource), 0u);
+    EXPECT_EQ(mLexer.getErrors().size(), errorCount);
+}
+
+TEST_F(LexerAllocTest, TRIVIA)
+{
+    mLexer.setOptions({ .keepTrivia = true });
+    countLexAllocations(validSource);
+    EXPECT_EQ(countLexAllocations(validSource), 0u);
+    EXPECT_FALSE(mLexer.getTrivia().empty());
+}
+
+TEST_F(LexerAllocTest, DIFFERENT_INPUTS)
+{
+    // Spare strings grow to the largest text seen at their position, so a few rounds settle any mix of inputs
+    for (int round = 0; round < 3; round++) {
+        countLexAllocations(validSource);
+        countLexAllocations(invalidSource);
+    }
+    EXPECT_EQ(countLexAllocations(validSource), 0u);
+    EXPECT_EQ(countLexAllocations(invalidSource), 0u);
+}
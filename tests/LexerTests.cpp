@@ -1,9 +1,33 @@
+#include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <memory>
+#include <sstream>
 #include <ranges>
+#include <thread>
 
+#include "BatchLexer.hpp"
+#include "Highlight.hpp"
+#include "FileHandler/LexerFileChecker.hpp"
+#include "FileHandler/LexerFilePipeline.hpp"
+#include "FileHandler/LexerFileReader.hpp"
+#include "FileHandler/LexerFileWriter.hpp"
+#include "FileHandler/LexerHighlightWriter.hpp"
+#include "FileHandler/LexerOutlineWriter.hpp"
+#include "FileHandler/LexerWatcher.hpp"
+#include "FileHandler/TokenRing.hpp"
 #include "LexerError.hpp"
+#include "LexerSinks.hpp"
 #include "LexicalAnalyzer.hpp"
+#include "LineIndex.hpp"
+#include "ProjectLexer.hpp"
+#include "Metrics.hpp"
+#include "OutlineScanner.hpp"
+#include "SymbolIndex.hpp"
+#include "SymbolTable.hpp"
 #include "Tokens.hpp"
+#include "Trace.hpp"
+#include "Utf8.hpp"
 
 TEST(LEXER_TEST, KEYWORD_IDENT)
 {
@@ -232,7 +256,7 @@ TEST(LEXER_TEST, OPERATORS)
     };
     ASSERT_EQ(tokens.size(), expectedTokens.size());
     for (const auto& [token, expectedToken] : std::views::zip(tokens, expectedTokens)) {
-        // EXPECT_EQ(tokenTypeToString.at(expectedToken), tokenTypeToString.at(token.type));
+        // EXPECT_EQ(tokenTypeToString(expectedToken), tokenTypeToString(token.type));
         EXPECT_EQ(expectedToken, token.type);
     }
 
@@ -380,3 +404,1024 @@ TEST(LEXER_TEST, MULTILINE_COMMENTS)
         EXPECT_EQ(expectedToken, token.type);
     }
 }
+
+TEST(LEXER_TEST, TOKEN_REGISTRY)
+{
+    for (std::size_t i = 0; i < TokenRegistry::tokenTypeCount; i++) {
+        TokenType type = static_cast<TokenType>(i);
+        std::optional<TokenType> roundTrip = tokenTypeFromString(tokenTypeToString(type));
+        ASSERT_TRUE(roundTrip.has_value());
+        EXPECT_EQ(type, roundTrip.value());
+    }
+
+    EXPECT_EQ(tokenTypeToString(TokenType::L_URL), "L_URL");
+    EXPECT_EQ(tokenTypeToString(TokenType::L_PORT), "L_PORT");
+    EXPECT_FALSE(tokenTypeFromString("K_POTATO").has_value());
+
+    EXPECT_EQ(keywordFromString("auto-move"), TokenType::K_AUTO_MOVE);
+    EXPECT_EQ(keywordFromString("double"), TokenType::K_TYPE);
+    EXPECT_FALSE(keywordFromString("potato").has_value());
+}
+
+TEST(LEXER_TEST, SYMBOL_INTERNING)
+{
+    auto symbols = std::make_shared<SymbolTable>();
+    LexicalAnalyzer lexer;
+    lexer.setSymbolTable(symbols);
+    lexer.buildTokens("let alpha = beta + alpha;");
+
+    const std::vector<Token>& tokens = lexer.getTokens();
+    ASSERT_EQ(tokens.size(), 7);
+    EXPECT_EQ(tokens[0].symbol, SymbolTable::npos);
+    EXPECT_EQ(tokens[1].symbol, 0u);
+    EXPECT_EQ(tokens[3].symbol, 1u);
+    EXPECT_EQ(tokens[5].symbol, tokens[1].symbol);
+    EXPECT_EQ(symbols->getName(tokens[3].symbol), "beta");
+
+    // Ids stay the same for other files using the table
+    LexicalAnalyzer otherLexer;
+    otherLexer.setSymbolTable(symbols);
+    otherLexer.buildTokens("beta gamma");
+    ASSERT_EQ(otherLexer.getTokens().size(), 2);
+    EXPECT_EQ(otherLexer.getTokens()[0].symbol, 1u);
+    EXPECT_EQ(otherLexer.getTokens()[1].symbol, 2u);
+
+    // Outputs only list the symbols of their file, renumbered from 0
+    nlohmann::json output = nlohmann::json::parse(LexerFileWriter::serialize(otherLexer, LineIndex { "beta gamma" }, "other.spc"));
+    EXPECT_EQ(output["symbols"], nlohmann::json({ "beta", "gamma" }));
+    EXPECT_EQ(output["tokens"][0]["symbol"], 0);
+    EXPECT_EQ(output["tokens"][1]["symbol"], 1);
+}
+
+TEST(LEXER_TEST, SYMBOL_TABLE_CONCURRENT)
+{
+    SymbolTable symbols;
+    std::vector<std::jthread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&symbols] {
+            for (int i = 0; i < 1000; i++) {
+                symbols.intern("name" + std::to_string(i));
+            }
+        });
+    }
+    threads.clear();
+
+    ASSERT_EQ(symbols.size(), 1000);
+    for (std::uint32_t id = 0; id < symbols.size(); id++) {
+        EXPECT_EQ(symbols.find(symbols.getName(id)), id);
+    }
+}
+
+TEST(LEXER_TEST, TOKEN_OFFSETS)
+{
+    const std::string test = "let s = \"a\\n\";\n  1.5+auto-potato /* x */ 'b'";
+    LexicalAnalyzer lexer { test };
+
+    const std::array<std::string_view, 11> expectedSource = {
+        "let", "s", "=", "\"a\\n\"", ";", "1.5", "+", "auto", "-", "potato", "'b'"
+    };
+    ASSERT_EQ(lexer.getTokens().size(), expectedSource.size());
+    for (const auto& [token, expected] : std::views::zip(lexer.getTokens(), expectedSource)) {
+        EXPECT_EQ(std::string_view(test).substr(token.offset, token.length), expected);
+    }
+
+    LineIndex lines { test };
+    SourcePosition position = lines.getPosition(lexer.getTokens()[5].offset);
+    EXPECT_EQ(position.line, 2u);
+    EXPECT_EQ(position.column, 3u);
+}
+
+TEST(LEXER_TEST, LINE_INDEX)
+{
+    std::string text;
+    std::vector<std::uint64_t> lineStarts = { 0 };
+    for (int i = 0; i < 100; i++) {
+        text.append(static_cast<std::size_t>(i % 37), 'x');
+        text.push_back('\n');
+        lineStarts.push_back(text.size());
+    }
+    text.append("tail");
+
+    LineIndex lines { text };
+    ASSERT_EQ(lines.getLineCount(), lineStarts.size());
+    for (std::uint64_t line = 1; line <= lineStarts.size(); line++) {
+        EXPECT_EQ(lines.getLineStart(line), lineStarts[line - 1]);
+        SourcePosition position = lines.getPosition(lineStarts[line - 1]);
+        EXPECT_EQ(position.line, line);
+        EXPECT_EQ(position.column, 1u);
+    }
+    EXPECT_EQ(lines.getPosition(text.size() - 1).column, 4u);
+}
+
+TEST(LEXER_TEST, TOKENS_IN_LINES)
+{
+    const std::string test = "let a;\nlet b = \"x\";\n\nfn c() {}\n";
+    LexicalAnalyzer lexer { test };
+    LineIndex lines { test };
+
+    std::span<const Token> secondLine = lexer.getTokensInLines(lines, 2, 3);
+    ASSERT_EQ(secondLine.size(), 5);
+    EXPECT_EQ(secondLine.front().type, TokenType::K_LET);
+    EXPECT_EQ(secondLine.back().type, TokenType::D_SEMICOLON);
+
+    EXPECT_TRUE(lexer.getTokensInLines(lines, 3, 4).empty());
+    EXPECT_EQ(lexer.getTokensInLines(lines, 1, 100).size(), lexer.getTokens().size());
+
+    // Tokens partly inside the byte range are kept
+    std::span<const Token> middle = lexer.getTokensInRange(1, 5);
+    ASSERT_EQ(middle.size(), 2);
+    EXPECT_EQ(middle.front().type, TokenType::K_LET);
+    EXPECT_EQ(middle.back().type, TokenType::IDENT);
+}
+
+TEST(LEXER_TEST, BATCH)
+{
+    std::vector<std::string> sources;
+    for (int i = 0; i < 64; i++) {
+        sources.push_back("fn f" + std::to_string(i) + "() { ret " + std::to_string(i) + "; }");
+    }
+    sources.push_back("'aa'");
+    sources.push_back("");
+    std::vector<std::string_view> views { sources.begin(), sources.end() };
+
+    // The second lexer splits even small batches across threads
+    BatchLexer sequential { 1 };
+    BatchLexer parallel { 4, 0 };
+    for (BatchLexer* batchLexer : { &sequential, &parallel }) {
+        const BatchResult& result = batchLexer->lex(views);
+        ASSERT_EQ(result.size(), sources.size());
+
+        for (std::size_t item = 0; item < sources.size(); item++) {
+            LexicalAnalyzer lexer { sources[item] };
+            std::span<const Token> tokens = result.getTokens(item);
+            ASSERT_EQ(tokens.size(), lexer.getTokens().size());
+            for (const auto& [token, expectedToken] : std::views::zip(tokens, lexer.getTokens())) {
+                EXPECT_EQ(token.type, expectedToken.type);
+                EXPECT_EQ(token.value, expectedToken.value);
+                EXPECT_EQ(token.offset, expectedToken.offset);
+            }
+            EXPECT_EQ(result.getErrors(item).size(), lexer.getErrors().size());
+        }
+        EXPECT_EQ(batchLexer->getSymbolTable().getName(result.getTokens(3)[1].symbol), "f3");
+        ASSERT_EQ(result.literals.size(), 64u);
+        EXPECT_EQ(result.tokens[result.literals[5].token].value, "5");
+    }
+}
+
+TEST(LEXER_TEST, FILE_PIPELINE)
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "specula-pipeline-test";
+    std::filesystem::create_directories(directory);
+    std::vector<std::string> files;
+    std::vector<std::string> sources;
+    for (int i = 0; i < 20; i++) {
+        files.push_back((directory / ("file" + std::to_string(i) + ".spc")).string());
+        sources.push_back("let x" + std::to_string(i) + " = " + std::to_string(i) + ";\n'aa'\nfn f() {}\n");
+        std::ofstream { files.back() } << sources.back();
+    }
+    files.push_back((directory / "missing.spc").string());
+
+    // Both backends must give what LexerFileWriter would have written, symbols are shared across the files
+    for (bool useIoUring : { true, false }) {
+        LexicalAnalyzer expectedLexer;
+        LexicalAnalyzer lexer;
+        LexerFilePipeline pipeline { lexer, 4, useIoUring };
+        std::vector<std::string> errors;
+        pipeline.run(files, [&errors](const std::string& message) { errors.push_back(message); });
+
+        ASSERT_EQ(errors.size(), 1u);
+        EXPECT_EQ(errors[0], "Cannot open file: " + files.back());
+        for (std::size_t i = 0; i < sources.size(); i++) {
+            expectedLexer.reset();
+            expectedLexer.buildTokens(sources[i]);
+            std::string expected = LexerFileWriter::serialize(expectedLexer, LineIndex { sources[i] }, files[i]);
+            std::ifstream outputFile { LexerFileWriter::getOutputPath(files[i]) };
+            std::string output { std::istreambuf_iterator<char> { outputFile }, {} };
+            EXPECT_EQ(output, expected);
+        }
+    }
+    std::filesystem::remove_all(directory);
+}
+
+TEST(LEXER_TEST, UTF8)
+{
+    EXPECT_EQ(Utf8::findInvalid("plain ascii text that is longer than one chunk"), std::string_view::npos);
+    EXPECT_EQ(Utf8::findInvalid("caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80"), std::string_view::npos);
+    EXPECT_EQ(Utf8::findInvalid("0123456789abcdef\xC0\xAF"), 16u); // overlong
+    EXPECT_EQ(Utf8::findInvalid("\xED\xA0\x80"), 0u); // surrogate
+    EXPECT_EQ(Utf8::findInvalid("ab\xE2\x82"), 2u); // cut short
+    EXPECT_EQ(Utf8::findInvalid("\xFF a \xFF", 1), 4u);
+
+    LexicalAnalyzer lexer { "let gr\xC3\xB6\xC3\x9F" "e = \"\xE6\x97\xA5\xE6\x9C\xAC\"; '\xC3\xA9'" };
+    const std::vector<Token>& tokens = lexer.getTokens();
+    ASSERT_EQ(tokens.size(), 6u);
+    EXPECT_EQ(tokens[1].type, TokenType::IDENT);
+    EXPECT_EQ(tokens[1].value, "gr\xC3\xB6\xC3\x9F" "e");
+    EXPECT_EQ(tokens[1].length, 7u);
+    EXPECT_EQ(tokens[3].type, TokenType::L_STRING);
+    EXPECT_EQ(tokens[3].value, "\xE6\x97\xA5\xE6\x9C\xAC");
+    EXPECT_EQ(tokens[5].type, TokenType::L_CHAR);
+    EXPECT_EQ(tokens[5].value, "\xC3\xA9");
+    EXPECT_TRUE(lexer.getErrors().empty());
+
+    // Malformed bytes end the identifier, strings keep them but report them
+    lexer.reset();
+    lexer.buildTokens("abc\xFF; \"x\xC3\"");
+    ASSERT_EQ(lexer.getErrors().size(), 2u);
+    EXPECT_EQ(lexer.getErrors()[0].offset, 3u);
+    EXPECT_EQ(lexer.getErrors()[1].offset, 8u);
+    EXPECT_EQ(lexer.getTokens()[0].value, "abc");
+    EXPECT_EQ(lexer.getTokens()[1].type, TokenType::UNKNOWN);
+    EXPECT_EQ(lexer.getTokens().back().type, TokenType::L_STRING);
+
+    // Writers still give valid JSON, with U+FFFD for the malformed bytes
+    std::string malformed = "let s = \"caf\xE9\"; x\xFF\n";
+    lexer.reset();
+    lexer.buildTokens(malformed);
+    LineIndex lines { malformed };
+    std::string output;
+    ASSERT_NO_THROW(output = LexerFileWriter::serialize(lexer, lines, "bad.spc"));
+    EXPECT_EQ(nlohmann::json::parse(output)["tokens"][3]["value"], "caf\xEF\xBF\xBD");
+    ASSERT_NO_THROW(output = LexerHighlightWriter::serialize(lexer, lines, "bad.spc"));
+    EXPECT_TRUE(nlohmann::json::accept(output));
+}
+
+TEST(LEXER_TEST, LITERAL_VALUES)
+{
+    LexicalAnalyzer lexer { "let a = 42; 3.25 1.5f 'x' '\\n' \"https://example.com:8443/api\" \":8080\" \"hello\" 99999999999999999999;" };
+    const std::vector<Literal>& literals = lexer.getLiterals();
+    ASSERT_EQ(literals.size(), 7u);
+
+    EXPECT_EQ(literals[0].kind, TokenType::L_INT);
+    EXPECT_EQ(std::get<std::int64_t>(literals[0].value), 42);
+    EXPECT_EQ(lexer.getTokens()[literals[0].token].value, "42");
+    EXPECT_EQ(std::get<double>(literals[1].value), 3.25);
+    EXPECT_EQ(std::get<float>(literals[2].value), 1.5f);
+    EXPECT_EQ(std::get<char32_t>(literals[3].value), U'x');
+    EXPECT_EQ(std::get<char32_t>(literals[4].value), U'\n');
+
+    EXPECT_EQ(literals[5].kind, TokenType::L_URL);
+    const UrlParts& url = std::get<UrlParts>(literals[5].value);
+    std::string_view urlText = lexer.getTokens()[literals[5].token].value;
+    EXPECT_EQ(urlText.substr(0, url.schemeLength), "https");
+    EXPECT_EQ(urlText.substr(url.hostOffset, url.hostLength), "example.com");
+    EXPECT_EQ(urlText.substr(url.pathOffset), "/api");
+    EXPECT_EQ(url.port, 8443);
+
+    EXPECT_EQ(literals[6].kind, TokenType::L_PORT);
+    EXPECT_EQ(std::get<std::uint16_t>(literals[6].value), 8080);
+    EXPECT_EQ(lexer.findLiteral(literals[6].token), &literals[6]);
+    EXPECT_EQ(lexer.findLiteral(0), nullptr);
+
+    // Too large for 64 bits, the token stays but gets no value
+    ASSERT_EQ(lexer.getErrors().size(), 1u);
+    EXPECT_EQ(lexer.getErrors()[0].message, "Integer literal out of range");
+
+    EXPECT_FALSE(parseUrl("not a url").has_value());
+    EXPECT_FALSE(parseUrl("http://:80").has_value());
+    EXPECT_FALSE(parseUrl("http://host:99999").has_value());
+    EXPECT_FALSE(parsePort(":").has_value());
+}
+
+TEST(LEXER_TEST, HIGHLIGHT_SPANS)
+{
+    const std::string source = "let x = 5; // note\nif (x) { ret 'ab'; } /* end */";
+    LexicalAnalyzer lexer { source };
+    ASSERT_EQ(lexer.getComments().size(), 2u);
+    EXPECT_EQ(source.substr(lexer.getComments()[0].offset, lexer.getComments()[0].length), "// note");
+    EXPECT_EQ(source.substr(lexer.getComments()[1].offset, lexer.getComments()[1].length), "/* end */");
+
+    std::vector<HighlightSpan> spans = buildHighlightSpans(lexer);
+    std::vector<std::pair<std::string, HighlightClass>> expected = {
+        { "let", HighlightClass::KEYWORD },
+        { "x", HighlightClass::IDENT },
+        { "=", HighlightClass::OPERATOR },
+        { "5", HighlightClass::LITERAL },
+        { ";", HighlightClass::OPERATOR },
+        { "// note", HighlightClass::COMMENT },
+        { "if", HighlightClass::KEYWORD },
+        { "(", HighlightClass::OPERATOR },
+        { "x", HighlightClass::IDENT },
+        { ")", HighlightClass::OPERATOR },
+        { "{", HighlightClass::OPERATOR },
+        { "ret", HighlightClass::KEYWORD },
+        { "'ab'", HighlightClass::ERROR },
+        { ";", HighlightClass::OPERATOR },
+        { "}", HighlightClass::OPERATOR },
+        { "/* end */", HighlightClass::COMMENT },
+    };
+    ASSERT_EQ(spans.size(), expected.size());
+    for (std::size_t i = 0; i < spans.size(); i++) {
+        EXPECT_EQ(source.substr(spans[i].offset, spans[i].length), expected[i].first) << i;
+        EXPECT_EQ(spans[i].kind, expected[i].second) << i;
+    }
+
+    // Neighbouring spans of one class become one
+    LexicalAnalyzer operators { "a=-(b)" };
+    std::vector<HighlightSpan> merged = buildHighlightSpans(operators);
+    ASSERT_EQ(merged.size(), 4u);
+    EXPECT_EQ(merged[1].length, 3u);
+
+    std::string output = LexerHighlightWriter::serialize(operators, LineIndex { "a=-(b)" }, "dir/file.spc");
+    nlohmann::json json = nlohmann::json::parse(output);
+    EXPECT_EQ(json["spans"], nlohmann::json({ 0, 1, 1, 0, 3, 3, 0, 1, 1, 0, 1, 3 }));
+    EXPECT_EQ(json["classes"][3], "operator");
+
+    // A block comment left open at the end still gets its span, up to the end
+    const std::string unclosed = "x /* open";
+    LexicalAnalyzer unclosedLexer { unclosed };
+    ASSERT_EQ(unclosedLexer.getErrors().size(), 1u);
+    EXPECT_EQ(unclosedLexer.getErrors()[0].message, "Multiline comment not closed");
+    EXPECT_EQ(unclosedLexer.getErrors()[0].offset, 2u);
+    std::vector<HighlightSpan> unclosedSpans = buildHighlightSpans(unclosedLexer);
+    ASSERT_EQ(unclosedSpans.size(), 2u);
+    EXPECT_EQ(unclosed.substr(unclosedSpans[1].offset, unclosedSpans[1].length), "/* open");
+    EXPECT_EQ(unclosedSpans[1].kind, HighlightClass::COMMENT);
+}
+
+TEST(LEXER_TEST, TRIVIA)
+{
+    const std::string source = "// header\r\nlet  x\t= \"a b\"; /* note */\n\n  fn f() {\n    ret x + 1; // done\n}\n";
+    LexicalAnalyzer withoutTrivia { source };
+    EXPECT_TRUE(withoutTrivia.getTrivia().empty());
+
+    LexicalAnalyzer lexer;
+    lexer.setOptions({ .keepTrivia = true });
+    lexer.buildTokens(source);
+
+    // Tokens and trivia together cover the source exactly
+    auto rebuild = [](const LexicalAnalyzer& lexed, std::string_view text) {
+        std::string rebuilt;
+        const std::vector<Token>& tokens = lexed.getTokens();
+        for (std::size_t i = 0; i <= tokens.size(); i++) {
+            for (const Trivia& trivia : lexed.getTriviaBefore(i)) {
+                rebuilt += text.substr(trivia.offset, trivia.length);
+            }
+            if (i < tokens.size()) {
+                rebuilt += text.substr(tokens[i].offset, tokens[i].length);
+            }
+        }
+        return rebuilt;
+    };
+    EXPECT_EQ(rebuild(lexer, source), source);
+
+    // Also when the text ends inside a block comment
+    const std::string unclosed = "let x = 1;\nx /* unterminated\n comment";
+    LexicalAnalyzer unclosedLexer;
+    unclosedLexer.setOptions({ .keepTrivia = true });
+    unclosedLexer.buildTokens(unclosed);
+    EXPECT_EQ(rebuild(unclosedLexer, unclosed), unclosed);
+    ASSERT_FALSE(unclosedLexer.getTrivia().empty());
+    EXPECT_EQ(unclosedLexer.getTrivia().back().kind, TriviaKind::COMMENT);
+
+    std::span<const Trivia> beforeLet = lexer.getTriviaBefore(0);
+    ASSERT_EQ(beforeLet.size(), 2u);
+    EXPECT_EQ(beforeLet[0].kind, TriviaKind::COMMENT);
+    EXPECT_EQ(beforeLet[1].kind, TriviaKind::NEW_LINE);
+    EXPECT_EQ(beforeLet[1].length, 2u); // "\r\n"
+    ASSERT_EQ(lexer.getTriviaBefore(1).size(), 1u);
+    EXPECT_EQ(lexer.getTriviaBefore(1)[0].length, 2u);
+}
+
+TEST(LEXER_TEST, LIMITS)
+{
+    const std::string source = "let a = 1; let b = 2; let c = 3;";
+
+    LexicalAnalyzer lexer;
+    lexer.setOptions({ .maxTokens = 6 });
+    lexer.buildTokens(source);
+    ASSERT_TRUE(lexer.getTruncation().has_value());
+    EXPECT_EQ(lexer.getTruncation()->limit, LexerLimit::TOKENS);
+    EXPECT_EQ(lexer.getTokens().size(), 6u);
+    EXPECT_EQ(lexer.getTokens().back().type, TokenType::K_LET);
+
+    // The identifier cut by the byte limit is dropped rather than saved short
+    lexer.reset();
+    lexer.setOptions({ .maxBytes = 13 });
+    lexer.buildTokens(source);
+    ASSERT_TRUE(lexer.getTruncation().has_value());
+    EXPECT_EQ(lexer.getTruncation()->limit, LexerLimit::BYTES);
+    EXPECT_EQ(lexer.getTruncation()->offset, 13u);
+    EXPECT_EQ(lexer.getTokens().size(), 5u);
+
+    lexer.reset();
+    lexer.setOptions({ .maxErrors = 1 });
+    lexer.buildTokens("'ab' 'cd' 'ef'");
+    EXPECT_EQ(lexer.getTruncation()->limit, LexerLimit::ERRORS);
+    EXPECT_EQ(lexer.getErrors().size(), 1u);
+
+    lexer.reset();
+    lexer.setOptions({});
+    lexer.buildTokens(source);
+    EXPECT_FALSE(lexer.getTruncation().has_value());
+    EXPECT_EQ(lexer.getTokens().size(), 15u);
+}
+
+TEST(LEXER_TEST, METRICS)
+{
+    // Every value maps into a bucket whose end is within 1/16 above it
+    for (std::uint64_t value : std::initializer_list<std::uint64_t> { 0, 31, 32, 1000, 123456789, UINT64_MAX }) {
+        std::size_t index = LatencyHistogram::getBucketIndex(value);
+        ASSERT_LT(index, LatencyHistogram::bucketCount);
+        EXPECT_GE(LatencyHistogram::getBucketLast(index), value);
+        EXPECT_LE(LatencyHistogram::getBucketLast(index) - value, value / 16);
+    }
+
+    LatencyHistogram histogram;
+    for (std::uint64_t value = 1; value <= 1000; value++) {
+        histogram.record(value);
+    }
+    EXPECT_EQ(histogram.getCount(), 1000u);
+    EXPECT_NEAR(static_cast<double>(histogram.getQuantile(0.5)), 500.0, 500.0 / 16);
+    EXPECT_NEAR(static_cast<double>(histogram.getQuantile(0.99)), 990.0, 990.0 / 16);
+
+    // Threads record into their own shards, the export sums them
+    LexMetrics metrics;
+    {
+        std::vector<std::jthread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&metrics] {
+                for (int i = 0; i < 100; i++) {
+                    metrics.record({ 2000, 10, i % 10 == 0 ? 1u : 0u, false, std::chrono::microseconds { 50 } });
+                }
+            });
+        }
+    }
+    std::ostringstream out;
+    metrics.writePrometheus(out);
+    std::string text = out.str();
+    EXPECT_NE(text.find("specula_lex_requests_total{size=\"16KiB\"} 400\n"), std::string::npos);
+    EXPECT_NE(text.find("specula_lex_tokens_total{size=\"16KiB\"} 4000\n"), std::string::npos);
+    EXPECT_NE(text.find("specula_lex_requests_with_errors_total{size=\"16KiB\"} 40\n"), std::string::npos);
+    EXPECT_NE(text.find("specula_lex_duration_seconds_bucket{size=\"16KiB\",le=\"0.0001\"} 400\n"), std::string::npos);
+    EXPECT_NE(text.find("specula_lex_duration_seconds_count{size=\"1KiB\"} 0\n"), std::string::npos);
+}
+
+TEST(LEXER_TEST, LEX_EXPECTED)
+{
+    LexicalAnalyzer lexer;
+    std::expected<LexResult, LexFailure> result = lexer.lex("let a = 'b'; \"\\b\"");
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result->tokens.size(), lexer.getTokens().size());
+    EXPECT_EQ(result->literals.size(), 1u);
+    // An escape without a value is an error in the result, not a failure
+    ASSERT_EQ(result->errors.size(), 1u);
+    EXPECT_EQ(result->errors[0].message, "Character is not a valid escape char");
+
+    lexer.reset();
+    lexer.setOptions({ .maxTokens = 2 });
+    result = lexer.lex("let a = 1;");
+    ASSERT_FALSE(result.has_value());
+    EXPECT_EQ(result.error().kind, LexFailureKind::LIMIT);
+    ASSERT_TRUE(result.error().truncation.has_value());
+    EXPECT_EQ(result.error().truncation->limit, LexerLimit::TOKENS);
+    EXPECT_EQ(lexer.getTokens().size(), 2u);
+
+    std::expected<std::string, LexFailure> source = LexerFileReader::readSource("does/not/exist.spc", 0);
+    ASSERT_FALSE(source.has_value());
+    EXPECT_EQ(source.error().kind, LexFailureKind::CANNOT_OPEN);
+}
+
+TEST(LEXER_TEST, PROJECT)
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "specula-project-test";
+    std::filesystem::create_directories(directory / "lib");
+    std::ofstream { directory / "main.spc" } << "import { add } from \"./util\";\nimport math from \"lib/math.spc\";\nlet x = add(1, 2);\n";
+    std::ofstream { directory / "util.spc" } << "import { pi } from \"lib/math\";\nexport { add } from \"./util\";\n";
+    std::ofstream { directory / "lib" / "math.spc" } << "import { gone } from \"../missing\";\nlet pi = 3.14;\n";
+
+    LexicalAnalyzer lexer { "import a from \"x\"; let from_y = 1; export * from \"y\"" };
+    std::vector<std::string_view> targets = ProjectLexer::getImportTargets(lexer.getTokens());
+    EXPECT_EQ(targets, (std::vector<std::string_view> { "x", "y" }));
+
+    // More threads than files, the idle ones must still stop
+    ProjectLexer projectLexer { 4 };
+    LexMetrics metrics;
+    projectLexer.setOptions({ .keepSymbolIndex = true });
+    projectLexer.setMetrics(&metrics);
+    std::vector<std::filesystem::path> roots { directory / "main.spc" };
+    const ProjectResult& result = projectLexer.lex(roots);
+    ASSERT_EQ(result.files.size(), 3u);
+    std::ostringstream metricsText;
+    metrics.writePrometheus(metricsText);
+    EXPECT_NE(metricsText.str().find("specula_lex_requests_total{size=\"1KiB\"} 3\n"), std::string::npos);
+
+    std::filesystem::path base = std::filesystem::canonical(directory);
+    std::optional<std::size_t> main = result.findFile(base / "main.spc");
+    std::optional<std::size_t> util = result.findFile(base / "util.spc");
+    std::optional<std::size_t> math = result.findFile(base / "lib" / "math.spc");
+    ASSERT_TRUE(main.has_value() && util.has_value() && math.has_value());
+    EXPECT_EQ(result.roots, std::vector<std::size_t> { *main });
+    EXPECT_EQ(result.files[*main].imports, (std::vector<std::size_t> { *util, *math }));
+    // A file importing itself is one edge, not another file
+    EXPECT_EQ(result.files[*util].imports, (std::vector<std::size_t> { *math, *util }));
+    EXPECT_TRUE(result.files[*math].imports.empty());
+    EXPECT_EQ(result.files[*math].unresolved, std::vector<std::string> { "../missing" });
+    for (const ProjectFile& file : result.files) {
+        EXPECT_FALSE(file.failure.has_value());
+        EXPECT_FALSE(file.lexer.getTokens().empty());
+    }
+    // pi is declared in math and imported by util
+    std::optional<std::uint32_t> pi = projectLexer.getSymbolTable().find("pi");
+    ASSERT_TRUE(pi.has_value());
+    std::span<const SymbolOccurrence> piUses = result.symbolIndex.find(*pi);
+    ASSERT_EQ(piUses.size(), 2u);
+    EXPECT_EQ(piUses[0].file, *math);
+    EXPECT_EQ(piUses[1].file, *util);
+    std::filesystem::remove_all(directory);
+}
+
+TEST(LEXER_TEST, WATCH)
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "specula-watch-test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    std::ofstream { directory / "a.spc" } << "let a = 1;";
+    std::ofstream { directory / "a_tokens.spc" } << "{}";
+
+    LexerWatcher watcher { directory };
+    std::vector<WatchChange> changes = watcher.lexAll();
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0].path, directory / "a.spc");
+    EXPECT_EQ(watcher.findFile(directory / "a.spc")->lexer.getTokens().size(), 5u);
+
+    // Only the changed file is lexed again, outputs written next to it are ignored
+    std::ofstream { directory / "a.spc" } << "let a = 1; let b = 2;";
+    std::ofstream { directory / "a_tokens.spc" } << "{}";
+    changes = watcher.poll(std::chrono::seconds { 2 });
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_FALSE(changes[0].isRemoved);
+    EXPECT_EQ(watcher.findFile(directory / "a.spc")->lexer.getTokens().size(), 10u);
+
+    std::filesystem::create_directories(directory / "sub");
+    std::ofstream { directory / "sub" / "b.spc" } << "b;";
+    std::filesystem::remove(directory / "a.spc");
+    changes = watcher.poll(std::chrono::seconds { 2 });
+    std::ranges::sort(changes, {}, &WatchChange::path);
+    ASSERT_EQ(changes.size(), 2u);
+    EXPECT_EQ(changes[0].path, directory / "a.spc");
+    EXPECT_TRUE(changes[0].isRemoved);
+    EXPECT_EQ(changes[1].path, directory / "sub" / "b.spc");
+    EXPECT_EQ(watcher.findFile(directory / "a.spc"), nullptr);
+    EXPECT_EQ(watcher.size(), 1u);
+
+    // Other extensions, hidden files and hidden directories like .git are neither lexed nor watched
+    std::filesystem::create_directories(directory / ".git" / "refs");
+    std::ofstream { directory / ".git" / "refs" / "main.spc" } << "x;";
+    std::ofstream { directory / ".b.spc" } << "x;";
+    std::ofstream { directory / "notes.txt" } << "x;";
+    changes = watcher.lexAll();
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0].path, directory / "sub" / "b.spc");
+    std::ofstream { directory / ".git" / "refs" / "main.spc" } << "x; y;";
+    std::ofstream { directory / "notes.txt" } << "x; y;";
+    EXPECT_TRUE(watcher.poll(std::chrono::milliseconds { 200 }).empty());
+
+    watcher.setExtensions({ ".spc", ".txt" });
+    changes = watcher.lexAll();
+    std::ranges::sort(changes, {}, &WatchChange::path);
+    ASSERT_EQ(changes.size(), 2u);
+    EXPECT_EQ(changes[0].path, directory / "notes.txt");
+    EXPECT_FALSE(changes[0].failure.has_value());
+    std::filesystem::remove_all(directory);
+}
+
+TEST(LEXER_TEST, PARALLEL_JSON)
+{
+    std::string source;
+    for (int i = 0; i < 500; i++) {
+        source += "let name" + std::to_string(i % 37) + " = \"text\\n" + std::to_string(i) + "\"; 'a' 1.5 @\n";
+    }
+    LexicalAnalyzer lexer;
+    lexer.setOptions({ .keepTrivia = true });
+    lexer.buildTokens(source);
+    LineIndex lines { source };
+    std::string expected = LexerFileWriter::serialize(lexer, lines, "dir/file.spc");
+
+    // Any split of the tokens must give the bytes of the sequential writer
+    for (unsigned int threads : { 1u, 3u, 8u, 5000u }) {
+        std::vector<std::string> pieces = LexerFileWriter::serializeChunks(lexer, lines, "dir/file.spc", lexer.getTokens(), threads);
+        std::string output;
+        for (const std::string& piece : pieces) {
+            output += piece;
+        }
+        // Compared as a bool, a diff of megabytes of JSON would not help
+        EXPECT_TRUE(output == expected) << threads << " threads";
+    }
+
+    // Without trivia nothing comes after the tokens
+    LexicalAnalyzer plain { source };
+    std::string plainOutput;
+    for (const std::string& piece : LexerFileWriter::serializeChunks(plain, lines, "dir/file.spc", plain.getTokens(), 3)) {
+        plainOutput += piece;
+    }
+    EXPECT_TRUE(plainOutput == LexerFileWriter::serialize(plain, lines, "dir/file.spc"));
+
+    // Malformed UTF-8 in every chunk must not throw on the worker threads
+    std::string malformed;
+    for (int i = 0; i < 4000; i++) {
+        malformed += "\"caf\xE9\" x\xFF\n";
+    }
+    LexicalAnalyzer malformedLexer { malformed };
+    LineIndex malformedLines { malformed };
+    std::string malformedOutput;
+    for (const std::string& piece : LexerFileWriter::serializeChunks(malformedLexer, malformedLines, "bad.spc", malformedLexer.getTokens(), 4)) {
+        malformedOutput += piece;
+    }
+    EXPECT_TRUE(malformedOutput == LexerFileWriter::serialize(malformedLexer, malformedLines, "bad.spc"));
+
+    LexicalAnalyzer empty { "" };
+    std::vector<std::string> pieces = LexerFileWriter::serializeChunks(empty, LineIndex { "" }, "empty.spc", empty.getTokens(), 4);
+    ASSERT_EQ(pieces.size(), 1u);
+    EXPECT_EQ(pieces[0], LexerFileWriter::serialize(empty, LineIndex { "" }, "empty.spc"));
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "specula-parallel-json.spc";
+    ASSERT_TRUE(LexerFileWriter::writeParallel(lexer, lines, path.string(), lexer.getTokens(), 4));
+    std::ifstream outputFile { LexerFileWriter::getOutputPath(path.string()) };
+    std::string output { std::istreambuf_iterator<char> { outputFile }, {} };
+    EXPECT_TRUE(output == LexerFileWriter::serialize(lexer, lines, path.string()));
+    std::filesystem::remove(LexerFileWriter::getOutputPath(path.string()));
+}
+
+TEST(LEXER_TEST, SYMBOL_INDEX)
+{
+    LexicalAnalyzer lexer;
+    lexer.setOptions({ .keepSymbolIndex = true });
+    lexer.buildTokens("let a = b; a = init-a + b; let c = a;");
+    SymbolIndex index = lexer.buildSymbolIndex();
+    const SymbolTable& symbols = lexer.getSymbolTable();
+    std::uint32_t a = *symbols.find("a");
+    std::uint32_t b = *symbols.find("b");
+
+    // Every use points back at an IDENT token with that symbol, in token order
+    std::span<const SymbolOccurrence> uses = index.find(a);
+    ASSERT_EQ(uses.size(), 4u);
+    for (const SymbolOccurrence& use : uses) {
+        EXPECT_EQ(lexer.getTokens()[use.token].symbol, a);
+    }
+    EXPECT_TRUE(std::ranges::is_sorted(uses, {}, &SymbolOccurrence::token));
+    EXPECT_EQ(index.find(b).size(), 2u);
+    EXPECT_TRUE(index.find(SymbolTable::npos).empty());
+    EXPECT_EQ(index.getSymbols().size(), 4u);
+
+    // Off by default
+    LexicalAnalyzer plain { "a b c" };
+    EXPECT_EQ(plain.buildSymbolIndex().size(), 0u);
+
+    // Merging keeps files apart and in order
+    lexer.reset();
+    lexer.buildTokens("b a");
+    SymbolIndex first = lexer.buildSymbolIndex();
+    lexer.reset();
+    lexer.buildTokens("a");
+    SymbolIndex last = lexer.buildSymbolIndex();
+    std::array<const SymbolIndex*, 2> files { &first, &last };
+    SymbolIndex merged = SymbolIndex::merge(files);
+    std::span<const SymbolOccurrence> mergedUses = merged.find(a);
+    ASSERT_EQ(mergedUses.size(), 2u);
+    EXPECT_EQ(mergedUses[0].file, 0u);
+    EXPECT_EQ(mergedUses[0].token, 1u);
+    EXPECT_EQ(mergedUses[1].file, 1u);
+    EXPECT_EQ(mergedUses[1].token, 0u);
+    ASSERT_EQ(merged.find(b).size(), 1u);
+}
+
+TEST(LEXER_TEST, BRACKET_MATCHES)
+{
+    LexicalAnalyzer lexer;
+    lexer.setOptions({ .keepBracketMatches = true });
+    lexer.buildTokens("contract { f(a[0]) { } }");
+    const std::vector<Token>& tokens = lexer.getTokens();
+    EXPECT_TRUE(lexer.getErrors().empty());
+
+    // Both sides find each other, skipping a body is one lookup
+    ASSERT_EQ(tokens[1].type, TokenType::D_CBRAC_OP);
+    ASSERT_EQ(lexer.findMatchingBracket(1), tokens.size() - 1);
+    EXPECT_EQ(lexer.findMatchingBracket(tokens.size() - 1), 1u);
+    EXPECT_EQ(lexer.findMatchingBracket(3), 8u);
+    EXPECT_EQ(lexer.findMatchingBracket(5), 7u);
+    EXPECT_EQ(lexer.findMatchingBracket(9), 10u);
+    EXPECT_FALSE(lexer.findMatchingBracket(0).has_value());
+    EXPECT_FALSE(lexer.findMatchingBracket(tokens.size()).has_value());
+
+    // A closing of the outer kind ends the unclosed inner opening
+    lexer.reset();
+    lexer.buildTokens("{ ( }");
+    ASSERT_EQ(lexer.getErrors().size(), 1u);
+    EXPECT_EQ(lexer.getErrors()[0].offset, 2u);
+    EXPECT_EQ(lexer.findMatchingBracket(0), 2u);
+    EXPECT_FALSE(lexer.findMatchingBracket(1).has_value());
+
+    // A stray closing is left unpaired, openings left at the end are reported
+    lexer.reset();
+    lexer.buildTokens(") [ (");
+    ASSERT_EQ(lexer.getErrors().size(), 3u);
+    EXPECT_EQ(lexer.getErrors()[0].offset, 0u);
+    EXPECT_EQ(lexer.getErrors()[1].offset, 2u);
+    EXPECT_EQ(lexer.getErrors()[2].offset, 4u);
+
+    // Off by default
+    LexicalAnalyzer plain { "( ] {" };
+    EXPECT_TRUE(plain.getErrors().empty());
+    EXPECT_FALSE(plain.findMatchingBracket(0).has_value());
+
+    // Pairs cut by a token limit are dropped
+    LexicalAnalyzer limited;
+    limited.setOptions({ .keepBracketMatches = true, .maxTokens = 3 });
+    limited.buildTokens("( ) ( a )");
+    EXPECT_EQ(limited.findMatchingBracket(0), 1u);
+    EXPECT_FALSE(limited.findMatchingBracket(2).has_value());
+    EXPECT_TRUE(limited.getErrors().empty());
+}
+
+TEST(LEXER_TEST, OUTLINE)
+{
+    std::string source = "import { a } from \"a\";\n"
+                         "// fn commented() {}\n"
+                         "contract Vault {\n"
+                         "    state Open { let s = \"}\"; let c = '{'; /* } */ }\n"
+                         "}\n"
+                         "let config = { fn: 1 };\n"
+                         "init-state Ready {}\n"
+                         "fn tick(x: int) { ret x.state; }\n"
+                         "interface Shape;\n"
+                         "struct Point { x: int }";
+    OutlineScanner scanner;
+    const std::vector<OutlineEntry>& entries = scanner.scan(source);
+    ASSERT_EQ(entries.size(), 5u);
+
+    // The contract comes first, then the state declared in its body, whose own body is skipped whole
+    EXPECT_EQ(entries[0].kind, TokenType::K_CONTRACT);
+    EXPECT_EQ(entries[0].name, "Vault");
+    EXPECT_EQ(source.substr(entries[0].offset, entries[0].length), "contract Vault {\n    state Open { let s = \"}\"; let c = '{'; /* } */ }\n}");
+    EXPECT_EQ(entries[1].kind, TokenType::K_STATE);
+    EXPECT_EQ(entries[1].name, "Open");
+    EXPECT_EQ(source.substr(entries[1].offset, entries[1].length), "state Open { let s = \"}\"; let c = '{'; /* } */ }");
+    EXPECT_EQ(entries[2].kind, TokenType::K_FN);
+    EXPECT_EQ(entries[2].name, "tick");
+    EXPECT_EQ(source.substr(entries[2].offset, entries[2].length), "fn tick(x: int) { ret x.state; }");
+    EXPECT_EQ(entries[3].kind, TokenType::K_INTERFACE);
+    EXPECT_EQ(entries[3].name, "Shape");
+    EXPECT_EQ(source.substr(entries[3].offset, entries[3].length), "interface Shape;");
+
+    std::string outline = LexerOutlineWriter::serialize(entries, LineIndex { source }, "dir/file.spc");
+    nlohmann::json output = nlohmann::json::parse(outline);
+    EXPECT_EQ(output["outline"][1]["line"], 4);
+    EXPECT_EQ(output["outline"][4]["kind"], "K_STRUCT");
+    EXPECT_EQ(output["outline"][4]["name"], "Point");
+    EXPECT_EQ(output["outline"][4]["line"], 10);
+    EXPECT_EQ(LexerOutlineWriter::getOutputPath("dir/file.spc"), std::filesystem::path { "dir/file_outline.spc" });
+
+    // An unclosed body runs to the end of the source
+    EXPECT_EQ(scanner.scan("struct Open { x").size(), 1u);
+    EXPECT_EQ(scanner.getEntries()[0].length, 15u);
+
+    // Only one level is scanned, and an unclosed contract still lists what its body declares
+    scanner.scan("listener L { fn ping() { state Hidden {} } } contract C { state S {}");
+    ASSERT_EQ(scanner.getEntries().size(), 4u);
+    EXPECT_EQ(scanner.getEntries()[1].name, "ping");
+    EXPECT_EQ(scanner.getEntries()[3].name, "S");
+}
+
+TEST(LEXER_TEST, TOKEN_RING)
+{
+    // The callback sees every token once, in order, and only those kept by the limits
+    std::string source;
+    for (int i = 0; i < 4000; i++) {
+        source += "let value = \"a string longer than what a record holds inline\";\n";
+    }
+    LexicalAnalyzer lexer;
+    std::vector<Token> published;
+    std::size_t calls = 0;
+    lexer.setTokenCallback([&](std::span<const Token> tokens) {
+        published.insert(published.end(), tokens.begin(), tokens.end());
+        calls++;
+    });
+    lexer.buildTokens(source);
+    ASSERT_EQ(published.size(), lexer.getTokens().size());
+    EXPECT_GT(calls, 1u);
+    EXPECT_EQ(published.back().offset, lexer.getTokens().back().offset);
+
+    lexer.reset();
+    published.clear();
+    lexer.setOptions({ .maxTokens = 10 });
+    lexer.buildTokens(source);
+    EXPECT_EQ(published.size(), 10u);
+    lexer.setTokenCallback({});
+
+    // A small ring makes the writer wait for the reader many times
+    TokenRingWriter writer { "specula-unit-test-ring", 64 };
+    TokenRingReader reader { "specula-unit-test-ring" };
+    LexicalAnalyzer ringLexer;
+    ringLexer.setTokenCallback([&writer](std::span<const Token> tokens) { writer.write(tokens); });
+    std::vector<TokenRecord> received;
+    std::jthread consumer { [&] {
+        std::array<TokenRecord, 16> records;
+        while (true) {
+            std::size_t count = reader.read(records);
+            if (count == 0) {
+                if (reader.isFinished()) {
+                    return;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            received.insert(received.end(), records.begin(), records.begin() + count);
+        }
+    } };
+    ringLexer.buildTokens(source);
+    writer.endFile(source.size());
+    writer.close();
+    consumer.join();
+
+    const std::vector<Token>& tokens = ringLexer.getTokens();
+    ASSERT_EQ(received.size(), tokens.size() + 1);
+    for (std::size_t i = 0; i < tokens.size(); i++) {
+        ASSERT_EQ(received[i].type, static_cast<std::uint16_t>(tokens[i].type));
+        ASSERT_EQ(received[i].offset, tokens[i].offset);
+        ASSERT_EQ(received[i].symbol, tokens[i].symbol);
+    }
+    EXPECT_EQ(std::string_view(received[1].value, received[1].valueSize), "value");
+    EXPECT_EQ(received[1].flags, 0);
+    EXPECT_EQ(received[3].flags, TokenRecord::isValueCut);
+    EXPECT_EQ(received[3].valueSize, sizeof(TokenRecord::value));
+    EXPECT_EQ(received.back().type, TokenRecord::endOfFile);
+    EXPECT_EQ(received.back().offset, source.size());
+
+    EXPECT_THROW(TokenRingReader { "specula-unit-test-missing-ring" }, std::invalid_argument);
+    // The name is taken and the consumer is attached until the writer and reader go
+    EXPECT_THROW(TokenRingWriter { "specula-unit-test-ring" }, std::invalid_argument);
+    EXPECT_THROW(TokenRingReader { "specula-unit-test-ring" }, std::invalid_argument);
+}
+
+TEST(LEXER_TEST, TOKEN_RING_CONSUMER_GONE)
+{
+    // Nothing reads a full ring, so the writer gives up at the timeout instead of waiting forever
+    std::vector<Token> tokens(8, Token { TokenType::IDENT, "name" });
+    {
+        TokenRingWriter writer { "specula-unit-test-lonely-ring", 4 };
+        writer.setTimeout(std::chrono::milliseconds { 50 });
+        EXPECT_FALSE(writer.write(tokens));
+        EXPECT_EQ(writer.getError(), TokenRingError::TIMED_OUT);
+        EXPECT_FALSE(writer.endFile(0));
+    }
+
+    // A consumer that detaches ends the wait at once, whatever the timeout
+    TokenRingWriter writer { "specula-unit-test-lonely-ring", 4 };
+    writer.setTimeout(std::chrono::hours { 1 });
+    std::optional<TokenRingReader> reader;
+    reader.emplace("specula-unit-test-lonely-ring");
+    std::array<TokenRecord, 2> records;
+    std::jthread consumer { [&] {
+        while (reader->read(records) == 0) {
+            std::this_thread::yield();
+        }
+        reader.reset();
+    } };
+    EXPECT_FALSE(writer.write(tokens));
+    EXPECT_EQ(writer.getError(), TokenRingError::CONSUMER_GONE);
+
+    // Replacing takes the name from the live writer
+    TokenRingWriter replacement { "specula-unit-test-lonely-ring", 4, true };
+    EXPECT_TRUE(replacement.write(std::span { tokens }.first(4)));
+}
+
+TEST(LEXER_TEST, TRACE)
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "specula_trace_test.json";
+    {
+        TraceSpan ignored { "before start" };
+    }
+    Trace::start();
+    {
+        TraceSpan span { "file", "dir/\"quoted\".spc" };
+        LexicalAnalyzer lexer { "let a = 1;" };
+    }
+    std::jthread { [] { LexicalAnalyzer lexer { "b" }; } }.join();
+    ASSERT_TRUE(Trace::write(path));
+    EXPECT_FALSE(Trace::isEnabled());
+
+    nlohmann::json trace = nlohmann::json::parse(std::ifstream { path });
+    std::filesystem::remove(path);
+    std::vector<nlohmann::json> spans;
+    for (const nlohmann::json& event : trace["traceEvents"]) {
+        if (event["ph"] == "X") {
+            spans.push_back(event);
+        }
+    }
+    // Spans are recorded when they end, so the lex inside the file span comes first
+    ASSERT_EQ(spans.size(), 3u);
+    EXPECT_EQ(spans[0]["name"], "lex");
+    EXPECT_EQ(spans[1]["name"], "file");
+    EXPECT_EQ(spans[1]["args"]["detail"], "dir/\"quoted\".spc");
+    EXPECT_EQ(spans[0]["tid"], spans[1]["tid"]);
+    EXPECT_LE(spans[1]["ts"].get<double>(), spans[0]["ts"].get<double>());
+    EXPECT_EQ(spans[2]["name"], "lex");
+    EXPECT_NE(spans[2]["tid"], spans[0]["tid"]);
+}
+
+TEST(LEXER_TEST, LEXER_SINKS)
+{
+    std::string text = "contract c { let a = 99999999999999999999; f(init-x, 'ab') } // done\n(";
+    LexerOptions options { .keepBracketMatches = true };
+    LexicalAnalyzer full;
+    full.setOptions(options);
+    full.buildTokens(text);
+    ASSERT_EQ(full.getErrors().size(), 3u);
+
+    // Every sink sees the same tokens and errors, only what is kept differs
+    CountingLexer counting;
+    counting.setOptions(options);
+    counting.buildTokens(text);
+    EXPECT_EQ(counting.getSink().getTokenCount(), full.getTokens().size());
+    // Literal values and bracket pairs are compiled out, and with them their errors
+    EXPECT_EQ(counting.getSink().getErrorCount(), 1u);
+    EXPECT_TRUE(counting.getComments().empty());
+
+    ValidatingLexer validating;
+    validating.setOptions(options);
+    validating.buildTokens(text);
+    EXPECT_EQ(validating.getSink().getTokenCount(), full.getTokens().size());
+    ASSERT_EQ(validating.getSink().getErrors().size(), full.getErrors().size());
+    for (std::size_t i = 0; i < full.getErrors().size(); i++) {
+        EXPECT_EQ(validating.getSink().getErrors()[i].message, full.getErrors()[i].message);
+        EXPECT_EQ(validating.getSink().getErrors()[i].offset, full.getErrors()[i].offset);
+    }
+    EXPECT_EQ(validating.getSymbolTable().size(), 0u);
+
+    // Batches are only valid during the call, keep copies
+    StreamingLexer streaming;
+    std::vector<Token> streamed;
+    std::size_t batchCount = 0;
+    streaming.getSink().setConsumer([&](std::span<const Token> batch) {
+        streamed.insert(streamed.end(), batch.begin(), batch.end());
+        batchCount++;
+    });
+    streaming.buildTokens(text);
+    streaming.buildTokens(text);
+    EXPECT_EQ(batchCount, 2u);
+    ASSERT_EQ(streamed.size(), 2 * full.getTokens().size());
+    for (std::size_t i = 0; i < full.getTokens().size(); i++) {
+        EXPECT_EQ(streamed[i].type, full.getTokens()[i].type);
+        EXPECT_EQ(streamed[i].value, full.getTokens()[i].value);
+        EXPECT_EQ(streamed[i].offset, full.getTokens()[i].offset);
+        EXPECT_EQ(streamed[i].symbol, full.getTokens()[i].symbol);
+    }
+
+    // Limits cut every sink at the same token
+    CountingLexer limited;
+    limited.setOptions({ .maxTokens = 5 });
+    limited.buildTokens(text);
+    EXPECT_EQ(limited.getSink().getTokenCount(), 5u);
+    ASSERT_TRUE(limited.getTruncation().has_value());
+    limited.reset();
+    EXPECT_EQ(limited.getSink().getTokenCount(), 0u);
+}
+
+TEST(LEXER_TEST, CHECK)
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "specula-check-test";
+    std::filesystem::create_directories(directory);
+    std::ofstream { directory / "good.spc" } << "fn f(a: int) { ret a; }\n";
+    std::ofstream { directory / "bad.spc" } << "let a = 1;\nlet b = \"x;\nlet c = 99999999999999999999;\n";
+    std::vector<std::string> files { (directory / "good.spc").string(), (directory / "bad.spc").string() };
+
+    // More threads than files, results stay in the order of the files
+    LexerFileChecker checker { {}, 4 };
+    const std::vector<FileCheck>& first = checker.check(files);
+    ASSERT_EQ(first.size(), 2u);
+    EXPECT_TRUE(first[0].errors.empty());
+    ASSERT_EQ(first[1].errors.size(), 1u);
+    EXPECT_EQ(first[1].errors[0].position.line, 2u);
+    EXPECT_EQ(first[1].errors[0].position.column, 12u);
+    EXPECT_FALSE(first[1].failure.has_value());
+    EXPECT_EQ(checker.getExitCode(), 1);
+
+    checker.setCollectingAllErrors(true);
+    const std::vector<FileCheck>& all = checker.check(files);
+    ASSERT_EQ(all[1].errors.size(), 2u);
+    EXPECT_EQ(all[1].errors[1].message, "Integer literal out of range");
+    EXPECT_EQ(all[1].errors[1].position.line, 3u);
+
+    // Nothing is written next to the inputs
+    EXPECT_FALSE(std::filesystem::exists(LexerFileWriter::getOutputPath(files[1])));
+
+    std::vector<std::string> clean { files[0] };
+    checker.check(clean);
+    EXPECT_EQ(checker.getExitCode(), 0);
+
+    // A file that cannot be read, or is only partly checked, fails the check
+    std::vector<std::string> missing { files[0], (directory / "missing.spc").string() };
+    const std::vector<FileCheck>& unread = checker.check(missing);
+    ASSERT_TRUE(unread[1].failure.has_value());
+    EXPECT_EQ(unread[1].failure->kind, LexFailureKind::CANNOT_OPEN);
+    EXPECT_EQ(checker.getExitCode(), 2);
+
+    LexerFileChecker limited { { .maxBytes = 5 }, 1 };
+    const std::vector<FileCheck>& cut = limited.check(clean);
+    ASSERT_TRUE(cut[0].failure.has_value());
+    EXPECT_EQ(cut[0].failure->truncation->limit, LexerLimit::BYTES);
+    EXPECT_EQ(limited.getExitCode(), 2);
+
+    std::filesystem::remove_all(directory);
+}